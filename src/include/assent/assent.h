@@ -5,6 +5,16 @@
 #ifndef ASSENT_H
 #define ASSENT_H
 
+#include <assent/hash_ring.h>
+#include <assent/latency_histogram.h>
+#include <assent/metrics.h>
+#include <assent/reorder_window.h>
+#include <assent/snapshots.h>
+#include <assent/step_ingest.h>
+#include <assent/step_queue.h>
+#include <assent/step_tree.h>
+#include <assent/tick_rate.h>
+#include <assent/trace.h>
 #include <nimble-steps/steps.h>
 #include <stdbool.h>
 #include <stddef.h>
@@ -19,13 +29,20 @@ struct AssentCallbackObject;
 typedef void (*AssentDeserializeStateFn)(void* self, const TransmuteState* state, StepId stepId);
 typedef void (*AssentPreAuthoritativeTicksFn)(void* self);
 typedef void (*AssentAuthoritativeTickFn)(void* self, const TransmuteInput* input, StepId stepId);
+typedef void (*AssentAuthoritativeTickBatchFn)(void* self, const TransmuteInput* inputs, size_t inputCount,
+                                               StepId firstStepId);
 typedef uint64_t (*AssentAuthoritativeHashFn)(void* self);
+typedef int (*AssentSerializeStateFn)(void* self, uint8_t* target, size_t maxTargetOctetCount);
+typedef void (*AssentRequestSnapshotFn)(void* self, StepId latestReceivedStepId);
 
 typedef struct AssentCallbackVtbl {
     AssentPreAuthoritativeTicksFn preTicksFn;
     AssentAuthoritativeTickFn tickFn;
     AssentDeserializeStateFn deserializeFn;
     AssentAuthoritativeHashFn hashFn;
+    AssentAuthoritativeTickBatchFn tickBatchFn; // optional, replaces tickFn with one call for all steps in an update
+    AssentSerializeStateFn serializeFn;         // optional, needed for snapshots
+    AssentRequestSnapshotFn requestSnapshotFn;  // optional, for skipToSnapshotBacklogThreshold and malformed steps
 } AssentCallbackVtbl;
 
 typedef struct AssentCallbackObject {
@@ -33,18 +50,68 @@ typedef struct AssentCallbackObject {
     void* self;
 } AssentCallbackObject;
 
+#define ASSENT_ADD_STEP_DUPLICATE (1) // the step has already been received
+#define ASSENT_ADD_STEP_STALE (2)     // the step has already been consumed
+
 #define TORNADO_CALLBACK(object, functionName) object.vtbl->functionName(object.self)
 #define TORNADO_CALLBACK_1(object, functionName, param1) object.vtbl->functionName(object.self, param1)
 #define TORNADO_CALLBACK_2(object, functionName, param1, param2) object.vtbl->functionName(object.self, param1, param2)
+#define TORNADO_CALLBACK_3(object, functionName, param1, param2, param3)                                              \
+    object.vtbl->functionName(object.self, param1, param2, param3)
+
+typedef struct AssentStepArrival {
+    StepId stepId;
+    uint64_t arrivalTimeNs;
+} AssentStepArrival;
 
 typedef struct Assent {
     AssentCallbackObject callbackObject;
     TransmuteInput lastTransmuteInput;
+    TransmuteParticipantInput* lastParticipantInputs;
+    TransmuteInput* batchTransmuteInputs;
+    TransmuteParticipantInput* batchParticipantInputs;
     size_t maxPlayerCount;
     size_t maxTicksPerRead;
+    uint64_t averageTickDurationNs;
     uint8_t* readTempBuffer;
     size_t readTempBufferSize;
+    uint8_t* writeTempBuffer;
+    size_t writeTempBufferSize;
     StepId stepId;
+    bool useTickRateController;
+    AssentTickRateController tickRateController;
+    size_t stateHashInterval;
+    AssentHashRing stateHashes;
+    uint64_t inputHash;
+    AssentHashRing inputHashes;
+    AssentStepTree stepTree;
+    size_t snapshotInterval;
+    AssentSnapshots snapshots;
+    size_t skipToSnapshotBacklogThreshold;
+    bool isSnapshotRequestPending;
+    StepId snapshotRequestedAtStepId;
+    bool useConcurrentIngest;
+    AssentStepQueue ingestQueue;
+    volatile uint64_t ingestExpectedStepId; // expectedWriteId of the authoritative steps, for the ingest thread
+    bool useMultiProducerIngest;
+    AssentStepIngest multiProducerIngest;
+    bool useDecodeAhead;
+    bool storeDecodedSteps;
+    AssentStepIngest decodedSteps; // TransmuteInput records decoded by the thread that added the steps
+    size_t decodedPayloadOctetCount;
+    bool useReorderWindow;
+    AssentReorderWindow reorderWindow;
+    bool measureUpdateTimings;
+    AssentUpdateMetrics updateMetrics;
+    AssentMetricsCounters metricsCounters;
+    bool measureStepLatency;
+    AssentStepArrival* stepArrivals; // when each waiting step was added, indexed by StepId modulo the capacity
+    size_t stepArrivalCapacity;
+    AssentLatencyHistogram stepLatencies;
+    bool useTrace;
+    AssentTrace trace;
+    uint64_t duplicateStepCount;
+    uint64_t staleStepCount;
     Clog log;
     NbsSteps authoritativeSteps;
 } Assent;
@@ -54,14 +121,59 @@ typedef struct AssentSetup {
     size_t maxTicksPerRead;
     size_t maxPlayers;
     size_t maxStepOctetSizeForSingleParticipant;
+    size_t targetBacklog;      // steps to keep buffered when catchUpUpdateCount is set
+    size_t catchUpUpdateCount; // if non-zero, spreads backlog above targetBacklog evenly over this many updates
+    size_t stateHashInterval;  // if non-zero, hashFn is called for every StepId that is a multiple of it
+    size_t stateHashHistoryCount;
+    size_t inputHashHistoryCount; // if non-zero, a rolling hash of the consumed steps is kept for this many steps
+    size_t stepTreeLeafCount;     // power of two, if non-zero range digests are kept for this many steps
+    size_t snapshotInterval;      // if non-zero, the state is serialized for every StepId that is a multiple of it
+    size_t snapshotCount;
+    size_t maxSnapshotOctetSize;
+    size_t snapshotBlockSize; // if non-zero, only the blocks changed since the previous snapshot are stored
+    size_t snapshotKeyframeInterval;
+    AssentSnapshotDirtyTracking snapshotDirtyTracking;
+    size_t skipToSnapshotBacklogThreshold; // if non-zero, a snapshot is requested when the backlog is larger
+    size_t concurrentIngestCapacity;       // if non-zero, steps can be added from one other thread than assentUpdate
+    size_t multiProducerIngestCapacity;    // if non-zero, steps can be added from any number of threads
+    size_t reorderWindowCapacity;          // if non-zero, steps arriving this far ahead of a missing step are kept
+    size_t decodeAheadCapacity;            // if non-zero, steps this far ahead are decoded when they are added
+    bool storeDecodedSteps;                // if set, steps are only stored decoded, see assentAddAuthoritativeStep()
+    bool measureUpdateTimings;             // if set, the parse, preTicksFn and tickFn durations are measured
+    bool measureStepLatency;               // if set, the time from adding a step until it is ticked is measured
+    size_t traceEventCapacity;             // if non-zero, the latest spans are kept for assentWriteTrace()
     Clog log;
 } AssentSetup;
 
+typedef struct AssentUpdateResult {
+    size_t stepsRun;
+    size_t stepsRemaining;
+} AssentUpdateResult;
+
 void assentInit(Assent* self, AssentCallbackObject callback, AssentSetup setup, TransmuteState state, StepId stepId);
 void assentDestroy(Assent* self);
 int assentUpdate(Assent* self);
+int assentUpdateWithBudget(Assent* self, uint64_t budgetNs, AssentUpdateResult* result);
 ssize_t assentAddAuthoritativeStep(Assent* self, const TransmuteInput* input, StepId tickId);
 int assentAddAuthoritativeStepRaw(Assent* self, const uint8_t* combinedAuthoritativeStep, size_t octetCount,
                                   StepId tickId);
+int assentAddAuthoritativeStepsRaw(Assent* self, StepId firstStepId, const uint8_t* combinedAuthoritativeSteps,
+                                   const size_t* octetCounts, size_t stepCount);
+int assentReserveAuthoritativeStep(Assent* self, StepId stepId, uint8_t** outOctets, size_t* outMaxOctetCount);
+int assentCommitAuthoritativeStep(Assent* self, StepId stepId, size_t octetCount);
+void assentCancelAuthoritativeStep(Assent* self, StepId stepId);
+const AssentUpdateMetrics* assentLastUpdateMetrics(const Assent* self);
+void assentMetricsTotals(const Assent* self, AssentMetricsTotals* target);
+void assentStepLatency(const Assent* self, AssentLatencySummary* target);
+void assentResetStepLatency(Assent* self);
+int assentWriteTrace(const Assent* self, char* target, size_t maxTargetOctetSize);
+void assentRedundantStepCounts(const Assent* self, uint64_t* outDuplicateCount, uint64_t* outStaleCount);
+size_t assentMissingSteps(const Assent* self, StepId* outStepIds, size_t maxCount);
+int assentStateHash(const Assent* self, StepId stepId, uint64_t* outHash);
+int assentInputHash(const Assent* self, StepId stepId, uint64_t* outHash);
+int assentStepRangeDigest(const Assent* self, size_t level, StepId firstStepId, uint64_t* outDigest);
+int assentSnapshot(Assent* self, StepId stepId, TransmuteState* outState, StepId* outStepId);
+void assentSnapshotMarkDirty(Assent* self, size_t octetOffset, size_t octetCount);
+void assentApplySnapshot(Assent* self, TransmuteState state, StepId stepId);
 
 #endif
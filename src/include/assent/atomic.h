@@ -0,0 +1,73 @@
+/*---------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved.
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------*/
+#ifndef ASSENT_ATOMIC_H
+#define ASSENT_ATOMIC_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#if defined _MSC_VER
+#include <intrin.h>
+#endif
+
+#define ASSENT_CACHE_LINE_OCTET_COUNT (64)
+
+// C99 has no atomics, so the compiler intrinsics are used directly. All operations are at least acquire/release.
+
+static inline uint64_t assentAtomicLoad(const volatile uint64_t* value)
+{
+#if defined _MSC_VER
+    return (uint64_t) _InterlockedOr64((volatile __int64*) value, 0);
+#else
+    return __atomic_load_n(value, __ATOMIC_ACQUIRE);
+#endif
+}
+
+static inline void assentAtomicStore(volatile uint64_t* value, uint64_t newValue)
+{
+#if defined _MSC_VER
+    _InterlockedExchange64((volatile __int64*) value, (__int64) newValue);
+#else
+    __atomic_store_n(value, newValue, __ATOMIC_RELEASE);
+#endif
+}
+
+static inline uint64_t assentAtomicFetchAdd(volatile uint64_t* value, uint64_t add)
+{
+#if defined _MSC_VER
+    return (uint64_t) _InterlockedExchangeAdd64((volatile __int64*) value, (__int64) add);
+#else
+    return __atomic_fetch_add(value, add, __ATOMIC_ACQ_REL);
+#endif
+}
+
+/// Full (sequentially consistent) barrier, orders a store before a later load.
+static inline void assentAtomicFence(void)
+{
+#if defined _MSC_VER
+    volatile __int64 barrier = 0;
+    _InterlockedOr64(&barrier, 0);
+#else
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+#endif
+}
+
+/// @return true if value was equal to `*expected` and has been replaced, otherwise `*expected` is updated
+static inline bool assentAtomicCompareExchange(volatile uint64_t* value, uint64_t* expected, uint64_t desired)
+{
+#if defined _MSC_VER
+    const uint64_t previous = (uint64_t) _InterlockedCompareExchange64((volatile __int64*) value, (__int64) desired,
+                                                                       (__int64) *expected);
+    if (previous == *expected) {
+        return true;
+    }
+    *expected = previous;
+    return false;
+#else
+    return __atomic_compare_exchange_n(value, expected, desired, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+#endif
+}
+
+#endif
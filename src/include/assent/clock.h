@@ -0,0 +1,12 @@
+/*---------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved.
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------*/
+#ifndef ASSENT_CLOCK_H
+#define ASSENT_CLOCK_H
+
+#include <stdint.h>
+
+uint64_t assentClockNowNs(void);
+
+#endif
@@ -0,0 +1,32 @@
+/*---------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved.
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------*/
+#ifndef ASSENT_HASH_RING_H
+#define ASSENT_HASH_RING_H
+
+#include <nimble-steps/steps.h>
+#include <stddef.h>
+#include <stdint.h>
+
+struct ImprintAllocator;
+
+typedef struct AssentStepHash {
+    StepId stepId;
+    uint64_t hash;
+} AssentStepHash;
+
+typedef struct AssentHashRing {
+    AssentStepHash* entries;
+    size_t capacity;
+    size_t headIndex;
+    size_t count;
+} AssentHashRing;
+
+void assentHashRingInit(AssentHashRing* self, struct ImprintAllocator* allocator, size_t capacity);
+void assentHashRingClear(AssentHashRing* self);
+void assentHashRingAdd(AssentHashRing* self, StepId stepId, uint64_t hash);
+int assentHashRingFind(const AssentHashRing* self, StepId stepId, uint64_t* outHash);
+const AssentStepHash* assentHashRingLatest(const AssentHashRing* self);
+
+#endif
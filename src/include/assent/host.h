@@ -0,0 +1,76 @@
+/*---------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved.
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------*/
+#ifndef ASSENT_HOST_H
+#define ASSENT_HOST_H
+
+#include <assent/assent.h>
+#include <assent/atomic.h>
+#include <assent/ready_queue.h>
+#include <assent/work_deque.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+struct ImprintAllocator;
+
+typedef enum AssentHostScheduling {
+    AssentHostSchedulingWorkStealing, // ready matches run roughly in the order they became ready
+    AssentHostSchedulingEarliestDeadline,
+} AssentHostScheduling;
+
+/// How urgent a match is for AssentHostSchedulingEarliestDeadline. All zero means the match that has waited
+/// the longest runs first.
+typedef struct AssentHostMatchPolicy {
+    uint64_t latencyTargetNs; // steps should be ticked within this time after they arrived
+    uint32_t priority;        // when deadlines have passed (overload), matches with higher priority run first
+    uint64_t updateBudgetNs;  // if non-zero, each update is limited to this much time, see assentUpdateWithBudget()
+    uint64_t maxWaitNs;       // if non-zero, a ready match runs before any other once it has waited this long
+} AssentHostMatchPolicy;
+
+typedef struct AssentHostMatch {
+    Assent* assent;
+    volatile uint64_t state;
+    AssentHostMatchPolicy policy;
+    volatile uint64_t readySinceNs;
+    volatile uint64_t backlog;
+    volatile uint64_t averageTickDurationNs;
+    volatile uint64_t missedDeadlineCount;
+} AssentHostMatch;
+
+typedef struct AssentHostWorker {
+    AssentWorkDeque deque;
+    volatile uint64_t updateCount;
+    volatile uint64_t stealCount;
+    bool hasRunOwnMatch; // only used by the thread of the worker
+} AssentHostWorker;
+
+/// Runs the assentUpdate() of many matches on a fixed number of workers. The threads are owned by the application,
+/// each calls assentHostWork() with its own worker index. A match is only scheduled when steps have been added to
+/// it, so idle matches cost nothing. With AssentHostSchedulingWorkStealing each worker keeps the matches it
+/// reschedules in its own deque, runs them oldest first, taking turns with newly ready matches, and a worker without
+/// work steals from the others. With
+/// AssentHostSchedulingEarliestDeadline the workers instead pick the ready match with the earliest deadline. Every
+/// pick scans all the matches and claims the chosen one with a compare-and-swap, so it costs O(matchCount) and the
+/// workers contend on the same match when several pick at once. That is fine for hundreds of matches per host, for
+/// many more, split them over several hosts.
+typedef struct AssentHost {
+    AssentHostScheduling scheduling;
+    AssentHostMatch* matches;
+    size_t matchCapacity;
+    volatile uint64_t matchCount;
+    AssentHostWorker* workers;
+    size_t workerCount;
+    AssentReadyQueue readyQueue;
+} AssentHost;
+
+void assentHostInit(AssentHost* self, struct ImprintAllocator* allocator, size_t matchCapacity, size_t workerCount,
+                    AssentHostScheduling scheduling);
+int assentHostAddMatch(AssentHost* self, Assent* assent, const AssentHostMatchPolicy* policy);
+void assentHostMatchReady(AssentHost* self, size_t matchIndex);
+int assentHostAddAuthoritativeStepRaw(AssentHost* self, size_t matchIndex, const uint8_t* combinedAuthoritativeStep,
+                                      size_t octetCount, StepId stepId);
+size_t assentHostWork(AssentHost* self, size_t workerIndex, size_t maxUpdateCount);
+
+#endif
@@ -0,0 +1,34 @@
+/*---------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved.
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------*/
+#ifndef ASSENT_LATENCY_HISTOGRAM_H
+#define ASSENT_LATENCY_HISTOGRAM_H
+
+#include <assent/atomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define ASSENT_LATENCY_HISTOGRAM_BUCKET_COUNT (252)
+
+typedef struct AssentLatencySummary {
+    uint64_t count;
+    uint64_t p50Ns;
+    uint64_t p99Ns;
+    uint64_t p999Ns;
+    uint64_t maxNs;
+} AssentLatencySummary;
+
+/// Fixed memory histogram of durations in nanoseconds. Every power of two is split into four buckets, so a
+/// reported percentile is at most 25% above the real value. It is written by one thread, but can be read and
+/// reset from any thread.
+typedef struct AssentLatencyHistogram {
+    volatile uint64_t buckets[ASSENT_LATENCY_HISTOGRAM_BUCKET_COUNT];
+} AssentLatencyHistogram;
+
+void assentLatencyHistogramInit(AssentLatencyHistogram* self);
+void assentLatencyHistogramAdd(AssentLatencyHistogram* self, uint64_t durationNs);
+void assentLatencyHistogramSummarize(const AssentLatencyHistogram* self, AssentLatencySummary* target);
+void assentLatencyHistogramReset(AssentLatencyHistogram* self);
+
+#endif
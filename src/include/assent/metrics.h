@@ -0,0 +1,50 @@
+/*---------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved.
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------*/
+#ifndef ASSENT_METRICS_H
+#define ASSENT_METRICS_H
+
+#include <assent/atomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/// What a single assentUpdate() did. The durations are only measured if AssentSetup::measureUpdateTimings is set.
+typedef struct AssentUpdateMetrics {
+    size_t stepsConsumed;
+    size_t maxStepCount;  // the most steps it could consume, chosen by the tick-rate controller if that is used
+    size_t backlogBefore; // authoritative steps waiting to be consumed, after moving in the ingested steps
+    size_t backlogAfter;
+    size_t octetsParsed;
+    size_t participantCount; // in the last consumed step
+    size_t stepsPreDecoded;  // consumed steps that were decoded when they were added, see decodeAheadCapacity
+    uint64_t parseNs;
+    uint64_t preTicksNs;
+    uint64_t tickNs;
+} AssentUpdateMetrics;
+
+/// Totals of all the updates so far.
+typedef struct AssentMetricsTotals {
+    uint64_t updateCount;
+    uint64_t stepsConsumed;
+    uint64_t octetsParsed;
+    uint64_t parseNs;
+    uint64_t preTicksNs;
+    uint64_t tickNs;
+} AssentMetricsTotals;
+
+/// Written by the simulation thread only, but can be read from any thread.
+typedef struct AssentMetricsCounters {
+    volatile uint64_t updateCount;
+    volatile uint64_t stepsConsumed;
+    volatile uint64_t octetsParsed;
+    volatile uint64_t parseNs;
+    volatile uint64_t preTicksNs;
+    volatile uint64_t tickNs;
+} AssentMetricsCounters;
+
+void assentMetricsCountersInit(AssentMetricsCounters* self);
+void assentMetricsCountersAdd(AssentMetricsCounters* self, const AssentUpdateMetrics* metrics);
+void assentMetricsCountersRead(const AssentMetricsCounters* self, AssentMetricsTotals* target);
+
+#endif
@@ -0,0 +1,34 @@
+/*---------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved.
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------*/
+#ifndef ASSENT_READY_QUEUE_H
+#define ASSENT_READY_QUEUE_H
+
+#include <assent/atomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+struct ImprintAllocator;
+
+typedef struct AssentReadyQueueCell {
+    volatile uint64_t sequence;
+    volatile uint64_t item;
+} AssentReadyQueueCell;
+
+/// Lock-free bounded multi-producer / multi-consumer queue of item indices (Vyukov).
+typedef struct AssentReadyQueue {
+    AssentReadyQueueCell* cells;
+    size_t capacity;
+    volatile uint64_t enqueueCount;
+    uint8_t enqueueCountPadding[ASSENT_CACHE_LINE_OCTET_COUNT - sizeof(uint64_t)];
+    volatile uint64_t dequeueCount;
+    uint8_t dequeueCountPadding[ASSENT_CACHE_LINE_OCTET_COUNT - sizeof(uint64_t)];
+} AssentReadyQueue;
+
+void assentReadyQueueInit(AssentReadyQueue* self, struct ImprintAllocator* allocator, size_t capacity);
+bool assentReadyQueueEnqueue(AssentReadyQueue* self, uint64_t item);
+bool assentReadyQueueDequeue(AssentReadyQueue* self, uint64_t* outItem);
+
+#endif
@@ -0,0 +1,41 @@
+/*---------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved.
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------*/
+#ifndef ASSENT_REORDER_WINDOW_H
+#define ASSENT_REORDER_WINDOW_H
+
+#include <nimble-steps/steps.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+struct ImprintAllocator;
+
+#define ASSENT_REORDER_WINDOW_STALE (1)
+#define ASSENT_REORDER_WINDOW_TOO_FAR_AHEAD (-1)
+#define ASSENT_REORDER_WINDOW_TOO_LARGE (-2)
+
+/// Holds combined steps that arrived ahead of the next expected StepId, until the steps in between have arrived.
+/// Every StepId in [nextStepId, nextStepId + capacity) has its own slot (StepId modulo capacity) and a bit in
+/// `presentBits` telling if it has been received.
+typedef struct AssentReorderWindow {
+    uint64_t* presentBits;
+    uint8_t* octets;
+    size_t* octetCounts;
+    size_t capacity;
+    size_t maxOctetCount;
+    StepId nextStepId;
+    StepId highestStepId; // only valid if count > 0
+    size_t count;
+} AssentReorderWindow;
+
+void assentReorderWindowInit(AssentReorderWindow* self, struct ImprintAllocator* allocator, size_t capacity,
+                             size_t maxOctetCount, StepId firstStepId);
+int assentReorderWindowInsert(AssentReorderWindow* self, StepId stepId, const uint8_t* octets, size_t octetCount);
+bool assentReorderWindowContains(const AssentReorderWindow* self, StepId stepId);
+bool assentReorderWindowPeek(const AssentReorderWindow* self, const uint8_t** outOctets, size_t* outOctetCount);
+void assentReorderWindowSkipTo(AssentReorderWindow* self, StepId stepId);
+size_t assentReorderWindowMissing(const AssentReorderWindow* self, StepId* outStepIds, size_t maxCount);
+
+#endif
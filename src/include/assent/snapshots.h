@@ -0,0 +1,62 @@
+/*---------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved.
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------*/
+#ifndef ASSENT_SNAPSHOTS_H
+#define ASSENT_SNAPSHOTS_H
+
+#include <nimble-steps/steps.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+struct ImprintAllocator;
+
+typedef struct AssentSnapshot {
+    StepId stepId;
+    uint8_t* octets;
+    size_t octetCount;
+    size_t stateOctetCount;
+    bool isKeyframe;
+} AssentSnapshot;
+
+typedef enum AssentSnapshotDirtyTracking {
+    AssentSnapshotDirtyTrackingCompareBlocks,
+    AssentSnapshotDirtyTrackingReportedBlocks,
+} AssentSnapshotDirtyTracking;
+
+typedef struct AssentSnapshots {
+    AssentSnapshot* snapshots;
+    size_t capacity;
+    size_t maxOctetCount;
+    size_t headIndex;
+    size_t count;
+
+    size_t blockSize;
+    size_t blockCount;
+    size_t keyframeInterval;
+    size_t snapshotsSinceKeyframe;
+    bool canWriteDelta;
+    AssentSnapshotDirtyTracking dirtyTracking;
+    uint64_t* dirtyBlocks;
+    uint8_t* stateBuffers[2];
+    size_t currentStateBufferIndex;
+    size_t previousStateOctetCount;
+    uint8_t* restoreBuffer;
+} AssentSnapshots;
+
+void assentSnapshotsInit(AssentSnapshots* self, struct ImprintAllocator* allocator, size_t capacity,
+                         size_t maxOctetCount);
+void assentSnapshotsInitIncremental(AssentSnapshots* self, struct ImprintAllocator* allocator, size_t blockSize,
+                                    size_t keyframeInterval, AssentSnapshotDirtyTracking dirtyTracking);
+void assentSnapshotsClear(AssentSnapshots* self);
+AssentSnapshot* assentSnapshotsBeginWrite(AssentSnapshots* self);
+void assentSnapshotsCommit(AssentSnapshots* self, StepId stepId, size_t octetCount);
+uint8_t* assentSnapshotsIncrementalTarget(AssentSnapshots* self);
+void assentSnapshotsCommitIncremental(AssentSnapshots* self, StepId stepId, size_t stateOctetCount);
+void assentSnapshotsMarkDirty(AssentSnapshots* self, size_t octetOffset, size_t octetCount);
+const AssentSnapshot* assentSnapshotsFindAtOrBefore(const AssentSnapshots* self, StepId stepId);
+int assentSnapshotsRestore(AssentSnapshots* self, const AssentSnapshot* snapshot, const uint8_t** outOctets,
+                           size_t* outOctetCount);
+
+#endif
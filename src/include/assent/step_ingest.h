@@ -0,0 +1,53 @@
+/*---------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved.
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------*/
+#ifndef ASSENT_STEP_INGEST_H
+#define ASSENT_STEP_INGEST_H
+
+#include <assent/atomic.h>
+#include <nimble-steps/steps.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+struct ImprintAllocator;
+
+#define ASSENT_STEP_INGEST_DUPLICATE (1)
+#define ASSENT_STEP_INGEST_TOO_FAR_AHEAD (-1)
+#define ASSENT_STEP_INGEST_TOO_LARGE (-2)
+
+typedef struct AssentStepIngestSlot {
+    volatile uint64_t state; // StepId the slot is for, shifted up two bits, and the slot phase in the lowest bits
+    size_t octetCount;
+    uint8_t* octets;
+    uint64_t arrivalTimeNs;
+} AssentStepIngestSlot;
+
+/// Lock-free multi-producer / single-consumer ingestion of combined steps. Every StepId has its own slot
+/// (StepId modulo capacity), so producers only contend when they add the same step, duplicates are rejected
+/// without copying and the consumer gets the steps in StepId order regardless of the order they arrived in.
+typedef struct AssentStepIngest {
+    AssentStepIngestSlot* slots;
+    size_t capacity;
+    size_t maxOctetCount;
+    StepId nextReadStepId; // only used by the consumer
+    volatile uint64_t duplicateCount;
+} AssentStepIngest;
+
+void assentStepIngestInit(AssentStepIngest* self, struct ImprintAllocator* allocator, size_t capacity,
+                          size_t maxOctetCount, StepId firstStepId);
+int assentStepIngestReserve(AssentStepIngest* self, StepId stepId, uint8_t** outOctets);
+void assentStepIngestCommit(AssentStepIngest* self, StepId stepId, size_t octetCount, uint64_t arrivalTimeNs);
+void assentStepIngestCancel(AssentStepIngest* self, StepId stepId);
+bool assentStepIngestIsTooFarAhead(const AssentStepIngest* self, StepId stepId);
+int assentStepIngestPush(AssentStepIngest* self, StepId stepId, const uint8_t* octets, size_t octetCount,
+                         uint64_t arrivalTimeNs);
+const AssentStepIngestSlot* assentStepIngestPeek(const AssentStepIngest* self);
+const AssentStepIngestSlot* assentStepIngestPeekAt(const AssentStepIngest* self, size_t offset);
+void assentStepIngestPop(AssentStepIngest* self);
+void assentStepIngestDrop(AssentStepIngest* self);
+size_t assentStepIngestReadyCount(const AssentStepIngest* self);
+void assentStepIngestSkipTo(AssentStepIngest* self, StepId stepId);
+
+#endif
@@ -0,0 +1,44 @@
+/*---------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved.
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------*/
+#ifndef ASSENT_STEP_QUEUE_H
+#define ASSENT_STEP_QUEUE_H
+
+#include <assent/atomic.h>
+#include <nimble-steps/steps.h>
+#include <stddef.h>
+#include <stdint.h>
+
+struct ImprintAllocator;
+
+typedef struct AssentStepQueueSlot {
+    StepId stepId;
+    uint8_t* octets;
+    size_t octetCount;
+    uint64_t arrivalTimeNs;
+} AssentStepQueueSlot;
+
+/// Lock-free single-producer / single-consumer queue of combined steps with preallocated slots.
+typedef struct AssentStepQueue {
+    AssentStepQueueSlot* slots;
+    size_t capacity;
+    size_t maxOctetCount;
+    StepId nextStepId;            // after the highest StepId committed, only used by the producer
+    volatile uint64_t writeCount; // only written by the producer
+    uint8_t writeCountPadding[ASSENT_CACHE_LINE_OCTET_COUNT - sizeof(uint64_t)];
+    volatile uint64_t readCount; // only written by the consumer
+    uint8_t readCountPadding[ASSENT_CACHE_LINE_OCTET_COUNT - sizeof(uint64_t)];
+} AssentStepQueue;
+
+void assentStepQueueInit(AssentStepQueue* self, struct ImprintAllocator* allocator, size_t capacity,
+                         size_t maxOctetCount);
+uint8_t* assentStepQueueReserve(AssentStepQueue* self);
+void assentStepQueueCommit(AssentStepQueue* self, StepId stepId, size_t octetCount, uint64_t arrivalTimeNs);
+int assentStepQueuePush(AssentStepQueue* self, StepId stepId, const uint8_t* octets, size_t octetCount,
+                        uint64_t arrivalTimeNs);
+const AssentStepQueueSlot* assentStepQueuePeek(const AssentStepQueue* self);
+void assentStepQueuePop(AssentStepQueue* self);
+size_t assentStepQueueCount(const AssentStepQueue* self);
+
+#endif
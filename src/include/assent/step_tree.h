@@ -0,0 +1,36 @@
+/*---------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved.
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------*/
+#ifndef ASSENT_STEP_TREE_H
+#define ASSENT_STEP_TREE_H
+
+#include <nimble-steps/steps.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+struct ImprintAllocator;
+
+#define ASSENT_STEP_TREE_MAX_LEVELS (24)
+
+typedef struct AssentStepTreeNode {
+    StepId firstStepId;
+    uint64_t hash;
+    bool isComplete;
+} AssentStepTreeNode;
+
+/// Hashes over aligned step ranges of 1, 2, 4 ... leafCount steps, for the latest leafCount steps.
+typedef struct AssentStepTree {
+    AssentStepTreeNode* nodes;
+    size_t levelOffsets[ASSENT_STEP_TREE_MAX_LEVELS];
+    size_t leafCount;
+    size_t levelCount;
+} AssentStepTree;
+
+void assentStepTreeInit(AssentStepTree* self, struct ImprintAllocator* allocator, size_t leafCount);
+void assentStepTreeClear(AssentStepTree* self);
+void assentStepTreeAdd(AssentStepTree* self, StepId stepId, uint64_t stepHash);
+int assentStepTreeDigest(const AssentStepTree* self, size_t level, StepId firstStepId, uint64_t* outDigest);
+
+#endif
@@ -0,0 +1,16 @@
+/*---------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved.
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------*/
+#ifndef ASSENT_STEPS_BORROW_H
+#define ASSENT_STEPS_BORROW_H
+
+#include <nimble-steps/steps.h>
+#include <stddef.h>
+#include <stdint.h>
+
+int assentStepsBorrow(const NbsSteps* steps, size_t offsetFromRead, StepId* outStepId, const uint8_t** outOctets,
+                      uint8_t* fallback, size_t fallbackOctetCount);
+int assentStepsRelease(NbsSteps* steps, size_t stepCount);
+
+#endif
@@ -0,0 +1,23 @@
+/*---------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved.
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------*/
+#ifndef ASSENT_TICK_RATE_H
+#define ASSENT_TICK_RATE_H
+
+#include <stddef.h>
+
+typedef struct AssentTickRateController {
+    size_t targetBacklog;
+    size_t catchUpUpdateCount;
+    size_t maxTicksPerUpdate;
+    size_t catchUpStepsLeft;   // extra steps still to tick in the current catch-up
+    size_t catchUpUpdatesLeft; // updates left to tick them in
+    size_t lastTickCount;
+} AssentTickRateController;
+
+void assentTickRateControllerInit(AssentTickRateController* self, size_t targetBacklog, size_t catchUpUpdateCount,
+                                  size_t maxTicksPerUpdate);
+size_t assentTickRateControllerChoose(AssentTickRateController* self, size_t backlog);
+
+#endif
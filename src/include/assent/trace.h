@@ -0,0 +1,43 @@
+/*---------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved.
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------*/
+#ifndef ASSENT_TRACE_H
+#define ASSENT_TRACE_H
+
+#include <assent/atomic.h>
+#include <nimble-steps/steps.h>
+#include <stddef.h>
+#include <stdint.h>
+
+struct ImprintAllocator;
+
+typedef enum AssentTraceEventType {
+    AssentTraceEventTypeUpdate,
+    AssentTraceEventTypeParse,
+    AssentTraceEventTypePreTicks,
+    AssentTraceEventTypeTick,
+    AssentTraceEventTypeIngest,
+} AssentTraceEventType;
+
+typedef struct AssentTraceEvent {
+    volatile uint64_t sequence; // index of the event plus one, zero while it is being written
+    volatile uint64_t startNs;
+    volatile uint64_t durationNs;
+    volatile uint64_t stepIdAndType; // StepId in the upper 32 bits, AssentTraceEventType in the lower
+    volatile uint64_t count;         // octets for parse and ingest, steps for update and tick
+} AssentTraceEvent;
+
+/// Lock-free ring of the latest spans. Any thread can add spans, older spans are overwritten when it is full.
+typedef struct AssentTrace {
+    AssentTraceEvent* events;
+    size_t capacity;
+    volatile uint64_t writeCount;
+} AssentTrace;
+
+void assentTraceInit(AssentTrace* self, struct ImprintAllocator* allocator, size_t capacity);
+void assentTraceAdd(AssentTrace* self, AssentTraceEventType type, uint64_t startNs, uint64_t durationNs,
+                    StepId stepId, uint64_t count);
+int assentTraceWriteChromeJson(const AssentTrace* self, char* target, size_t maxTargetOctetSize);
+
+#endif
@@ -0,0 +1,31 @@
+/*---------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved.
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------*/
+#ifndef ASSENT_WORK_DEQUE_H
+#define ASSENT_WORK_DEQUE_H
+
+#include <assent/atomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+struct ImprintAllocator;
+
+/// Lock-free work-stealing deque (Chase-Lev) of item indices with a fixed capacity. The owning worker pushes and
+/// pops at the bottom, any other worker can steal from the top.
+typedef struct AssentWorkDeque {
+    volatile uint64_t* items;
+    size_t capacity;
+    volatile uint64_t top; // written by thieves and by the owner when taking the last item
+    uint8_t topPadding[ASSENT_CACHE_LINE_OCTET_COUNT - sizeof(uint64_t)];
+    volatile uint64_t bottom; // only written by the owner
+    uint8_t bottomPadding[ASSENT_CACHE_LINE_OCTET_COUNT - sizeof(uint64_t)];
+} AssentWorkDeque;
+
+void assentWorkDequeInit(AssentWorkDeque* self, struct ImprintAllocator* allocator, size_t capacity);
+bool assentWorkDequePush(AssentWorkDeque* self, uint64_t item);
+bool assentWorkDequePop(AssentWorkDeque* self, uint64_t* outItem);
+bool assentWorkDequeSteal(AssentWorkDeque* self, uint64_t* outItem);
+
+#endif
@@ -4,10 +4,86 @@
  *--------------------------------------------------------------------------------------------*/
 #include "nimble-steps-serialize/out_serialize.h"
 #include <assent/assent.h>
+#include <assent/clock.h>
+#include <assent/hash_mix.h>
+#include <assent/steps_borrow.h>
 #include <imprint/allocator.h>
 #include <inttypes.h>
 #include <mash/murmur.h>
 #include <nimble-steps-serialize/in_serialize.h>
+#include <tiny-libc/tiny_libc.h>
+
+/// The start of a decode-ahead record. The hash of the combined step octets tells the record apart from one that
+/// was decoded from another version of the step, e.g. one that was rejected and then added again.
+typedef struct AssentDecodedStep {
+    TransmuteInput input;
+    uint32_t octetsHash;
+} AssentDecodedStep;
+
+/// Hashes the authoritative state if the current StepId is scheduled for hashing.
+/// The schedule only depends on the StepId, so all peers hash the state at the same steps.
+static void hashStateIfScheduled(Assent* self)
+{
+    if (self->stateHashInterval == 0 || self->stepId % self->stateHashInterval != 0) {
+        return;
+    }
+
+    const uint64_t hash = TORNADO_CALLBACK(self->callbackObject, hashFn);
+    assentHashRingAdd(&self->stateHashes, self->stepId, hash);
+}
+
+/// Hashes a consumed combined step and chains it onto the rolling input hash and the step tree. Two peers that
+/// have the same rolling hash for a StepId have received identical steps up to and including it.
+static void hashConsumedStep(Assent* self, StepId stepId, const uint8_t* combinedStepOctets, size_t octetCount)
+{
+    if (self->inputHashes.capacity == 0 && self->stepTree.leafCount == 0) {
+        return;
+    }
+
+    const uint32_t octetsHash = mashMurmurHash3(combinedStepOctets, octetCount);
+    const uint64_t stepHash = ((uint64_t) stepId << 32) | octetsHash;
+
+    self->inputHash = assentHashMix64(self->inputHash ^ stepHash);
+    assentHashRingAdd(&self->inputHashes, stepId, self->inputHash);
+
+    assentStepTreeAdd(&self->stepTree, stepId, assentHashMix64(stepHash));
+}
+
+static void snapshotStateIfScheduled(Assent* self)
+{
+    if (self->snapshotInterval == 0 || self->stepId % self->snapshotInterval != 0) {
+        return;
+    }
+
+    const bool isIncremental = self->snapshots.blockSize != 0;
+    uint8_t* target = isIncremental ? assentSnapshotsIncrementalTarget(&self->snapshots)
+                                    : assentSnapshotsBeginWrite(&self->snapshots)->octets;
+
+    const int octetCount = self->callbackObject.vtbl->serializeFn(self->callbackObject.self, target,
+                                                                  self->snapshots.maxOctetCount);
+    if (octetCount < 0) {
+        CLOG_C_SOFT_ERROR(&self->log, "could not serialize snapshot for %04X (%d)", self->stepId, octetCount)
+        return;
+    }
+
+    if (isIncremental) {
+        assentSnapshotsCommitIncremental(&self->snapshots, self->stepId, (size_t) octetCount);
+    } else {
+        assentSnapshotsCommit(&self->snapshots, self->stepId, (size_t) octetCount);
+    }
+}
+
+/// Called every time the authoritative state has reached a new StepId.
+static void onAuthoritativeStepReached(Assent* self)
+{
+    hashStateIfScheduled(self);
+    snapshotStateIfScheduled(self);
+}
+
+static size_t stepsToNextMultiple(StepId stepId, size_t interval)
+{
+    return interval - stepId % interval;
+}
 
 void assentInit(Assent* self, AssentCallbackObject callbackObject, AssentSetup setup, TransmuteState state,
                 StepId stepId)
@@ -16,24 +92,129 @@ void assentInit(Assent* self, AssentCallbackObject callbackObject, AssentSetup s
     self->callbackObject = callbackObject;
     self->maxPlayerCount = setup.maxPlayers;
     self->maxTicksPerRead = setup.maxTicksPerRead;
-    self->lastTransmuteInput.participantInputs = IMPRINT_ALLOC_TYPE_COUNT(setup.allocator, TransmuteParticipantInput,
-                                                                          setup.maxPlayers);
+    self->averageTickDurationNs = 0;
+    self->useTickRateController = setup.catchUpUpdateCount != 0;
+    assentTickRateControllerInit(&self->tickRateController, setup.targetBacklog, setup.catchUpUpdateCount,
+                                 setup.maxTicksPerRead);
+
+    self->stateHashInterval = setup.stateHashInterval;
+    CLOG_ASSERT(self->stateHashInterval == 0 || callbackObject.vtbl->hashFn != 0,
+                "hashFn must be set when stateHashInterval is used")
+    assentHashRingInit(&self->stateHashes, setup.allocator,
+                       self->stateHashInterval == 0 ? 0 : setup.stateHashHistoryCount);
+    self->inputHash = 0;
+    assentHashRingInit(&self->inputHashes, setup.allocator, setup.inputHashHistoryCount);
+    assentStepTreeInit(&self->stepTree, setup.allocator, setup.stepTreeLeafCount);
+
+    self->snapshotInterval = setup.snapshotInterval;
+    CLOG_ASSERT(self->snapshotInterval == 0 || callbackObject.vtbl->serializeFn != 0,
+                "serializeFn must be set when snapshotInterval is used")
+    CLOG_ASSERT(self->snapshotInterval == 0 || setup.snapshotCount > 0, "snapshotCount must be set")
+    assentSnapshotsInit(&self->snapshots, setup.allocator, self->snapshotInterval == 0 ? 0 : setup.snapshotCount,
+                        setup.maxSnapshotOctetSize);
+    if (self->snapshotInterval != 0 && setup.snapshotBlockSize != 0) {
+        assentSnapshotsInitIncremental(&self->snapshots, setup.allocator, setup.snapshotBlockSize,
+                                       setup.snapshotKeyframeInterval, setup.snapshotDirtyTracking);
+    }
+
+    self->lastParticipantInputs = IMPRINT_ALLOC_TYPE_COUNT(setup.allocator, TransmuteParticipantInput,
+                                                           setup.maxPlayers);
+    self->lastTransmuteInput.participantInputs = self->lastParticipantInputs;
     self->lastTransmuteInput.participantCount = 0;
 
+    self->batchTransmuteInputs = 0;
+    self->batchParticipantInputs = 0;
+    if (callbackObject.vtbl->tickBatchFn != 0) {
+        self->batchTransmuteInputs = IMPRINT_ALLOC_TYPE_COUNT(setup.allocator, TransmuteInput, setup.maxTicksPerRead);
+        self->batchParticipantInputs = IMPRINT_ALLOC_TYPE_COUNT(setup.allocator, TransmuteParticipantInput,
+                                                                setup.maxTicksPerRead * setup.maxPlayers);
+        for (size_t i = 0; i < setup.maxTicksPerRead; ++i) {
+            self->batchTransmuteInputs[i].participantInputs = &self->batchParticipantInputs[i * setup.maxPlayers];
+            self->batchTransmuteInputs[i].participantCount = 0;
+        }
+    }
+
+    self->skipToSnapshotBacklogThreshold = setup.skipToSnapshotBacklogThreshold;
+    CLOG_ASSERT(self->skipToSnapshotBacklogThreshold == 0 || callbackObject.vtbl->requestSnapshotFn != 0,
+                "requestSnapshotFn must be set when skipToSnapshotBacklogThreshold is used")
+    self->isSnapshotRequestPending = false;
+    self->snapshotRequestedAtStepId = 0;
+
     const size_t combinedStepOctetCount = nbsStepsOutSerializeCalculateCombinedSize(
         setup.maxPlayers, setup.maxStepOctetSizeForSingleParticipant);
     self->readTempBufferSize = combinedStepOctetCount;
     self->readTempBuffer = IMPRINT_ALLOC_TYPE_COUNT(setup.allocator, uint8_t, self->readTempBufferSize);
+    self->writeTempBufferSize = combinedStepOctetCount;
+    self->writeTempBuffer = IMPRINT_ALLOC_TYPE_COUNT(setup.allocator, uint8_t, self->writeTempBufferSize);
+
+    self->useConcurrentIngest = setup.concurrentIngestCapacity != 0;
+    if (self->useConcurrentIngest) {
+        assentStepQueueInit(&self->ingestQueue, setup.allocator, setup.concurrentIngestCapacity,
+                            combinedStepOctetCount);
+    }
+    assentAtomicStore(&self->ingestExpectedStepId, stepId);
+    self->useMultiProducerIngest = setup.multiProducerIngestCapacity != 0;
+    CLOG_ASSERT(!(self->useConcurrentIngest && self->useMultiProducerIngest),
+                "use either concurrentIngestCapacity or multiProducerIngestCapacity")
+    if (self->useMultiProducerIngest) {
+        assentStepIngestInit(&self->multiProducerIngest, setup.allocator, setup.multiProducerIngestCapacity,
+                             combinedStepOctetCount, stepId);
+    }
+
+    self->useDecodeAhead = setup.decodeAheadCapacity != 0;
+    if (self->useDecodeAhead) {
+        // a record is the AssentDecodedStep, followed by the participant inputs and then their payloads
+        self->decodedPayloadOctetCount = setup.maxPlayers * setup.maxStepOctetSizeForSingleParticipant;
+        const size_t recordOctetCount = sizeof(AssentDecodedStep) +
+                                        setup.maxPlayers * sizeof(TransmuteParticipantInput) +
+                                        self->decodedPayloadOctetCount;
+        assentStepIngestInit(&self->decodedSteps, setup.allocator, setup.decodeAheadCapacity,
+                             (recordOctetCount + 7U) & ~(size_t) 7U, stepId);
+    }
+    self->storeDecodedSteps = setup.storeDecodedSteps;
+    CLOG_ASSERT(!self->storeDecodedSteps || self->useDecodeAhead, "storeDecodedSteps needs decodeAheadCapacity")
+    CLOG_ASSERT(!self->storeDecodedSteps || (!self->useConcurrentIngest && !self->useMultiProducerIngest &&
+                                             setup.reorderWindowCapacity == 0),
+                "steps stored decoded can already be added from any thread and in any order")
+    CLOG_ASSERT(!self->storeDecodedSteps || (setup.inputHashHistoryCount == 0 && setup.stepTreeLeafCount == 0),
+                "input hashes and step range digests are calculated from serialized steps")
+
+    self->measureUpdateTimings = setup.measureUpdateTimings;
+    self->measureStepLatency = setup.measureStepLatency;
+    self->useTrace = setup.traceEventCapacity != 0;
+    if (self->useTrace) {
+        assentTraceInit(&self->trace, setup.allocator, setup.traceEventCapacity);
+    }
+    assentLatencyHistogramInit(&self->stepLatencies);
+    tc_mem_clear_type(&self->updateMetrics);
+    assentMetricsCountersInit(&self->metricsCounters);
+    self->duplicateStepCount = 0;
+    self->staleStepCount = 0;
+    self->useReorderWindow = setup.reorderWindowCapacity != 0;
+    if (self->useReorderWindow) {
+        assentReorderWindowInit(&self->reorderWindow, setup.allocator, setup.reorderWindowCapacity,
+                                combinedStepOctetCount, stepId);
+    }
+
+    if (self->measureStepLatency) {
+        // room for every step that can be waiting in the authoritative steps and in the reorder window
+        self->stepArrivalCapacity = NBS_WINDOW_SIZE + (self->useReorderWindow ? self->reorderWindow.capacity : 0);
+        self->stepArrivals = IMPRINT_CALLOC_TYPE_COUNT(setup.allocator, AssentStepArrival, self->stepArrivalCapacity);
+    }
 
     nbsStepsInit(&self->authoritativeSteps, setup.allocator, combinedStepOctetCount, setup.log);
     nbsStepsReInit(&self->authoritativeSteps, stepId);
     callbackObject.vtbl->deserializeFn(callbackObject.self, &state, stepId);
 
-    CLOG_EXECUTE(uint64_t authoritativeHash = callbackObject.vtbl->hashFn(callbackObject.self);)
+    CLOG_EXECUTE(uint64_t authoritativeHash = callbackObject.vtbl->hashFn != 0
+                                                  ? callbackObject.vtbl->hashFn(callbackObject.self)
+                                                  : 0;)
 
     CLOG_C_DEBUG(&self->log, "assentInit stepId:%04X octetSize:%zu authoritative hash: %08" PRIX64, stepId,
                  state.octetSize, authoritativeHash)
     self->stepId = stepId;
+
+    onAuthoritativeStepReached(self);
 }
 
 void assentDestroy(Assent* self)
@@ -58,72 +239,692 @@ static TransmuteParticipantInputType toTransmuteInput(NimbleSerializeStepType st
     CLOG_ERROR("toTransmuteInput() not a valid connect state in assent %u", state)
 }
 
-int assentUpdate(Assent* self)
+/// Timestamp for when a step was added, only taken if step latency is measured.
+static uint64_t stepArrivalTimeNs(const Assent* self)
+{
+    return self->measureStepLatency ? assentClockNowNs() : 0;
+}
+
+/// Start time for a trace span, only taken if tracing is enabled.
+static uint64_t traceStartNs(const Assent* self)
+{
+    return self->useTrace ? assentClockNowNs() : 0;
+}
+
+static void traceSpan(Assent* self, AssentTraceEventType type, uint64_t startNs, StepId stepId, uint64_t count)
+{
+    if (!self->useTrace) {
+        return;
+    }
+
+    assentTraceAdd(&self->trace, type, startNs, assentClockNowNs() - startNs, stepId, count);
+}
+
+/// Decodes a combined step into target, with the payloads pointing into octets. Only reads self, so it can be
+/// called from the threads adding steps.
+/// @return 0 on success, the negative parser result if the octets are not a combined step, or -99 if there are more
+/// participants than maxPlayers (target->participantCount is still set).
+static int decodeCombinedStep(const Assent* self, const uint8_t* octets, size_t octetCount, TransmuteInput* target)
+{
+    NimbleStepsOutSerializeLocalParticipants participants;
+
+    const int parseResult = nbsStepsInSerializeStepsForParticipantsFromOctets(&participants, octets, octetCount);
+    if (parseResult < 0) {
+        target->participantCount = 0;
+        return parseResult;
+    }
+
+    target->participantCount = participants.participantCount;
+    if (participants.participantCount > self->maxPlayerCount) {
+        return -99;
+    }
+
+    for (size_t i = 0; i < participants.participantCount; ++i) {
+        NimbleStepsOutSerializeLocalParticipant* participant = &participants.participants[i];
+        target->participantInputs[i].participantId = participant->participantId;
+        target->participantInputs[i].localPartyId = participant->localPartyId;
+        target->participantInputs[i].inputType = toTransmuteInput(participant->stepType);
+        target->participantInputs[i].input = participant->payload;
+        target->participantInputs[i].octetSize = participant->payloadCount;
+    }
+
+    return 0;
+}
+
+static int parseCombinedStep(Assent* self, StepId stepId, const uint8_t* octets, size_t octetCount,
+                             TransmuteInput* target)
+{
+    const bool measureParse = self->measureUpdateTimings || self->useTrace;
+    const uint64_t parseStartNs = measureParse ? assentClockNowNs() : 0;
+
+    const int decodeResult = decodeCombinedStep(self, octets, octetCount, target);
+    if (decodeResult == -99) {
+        CLOG_C_SOFT_ERROR(&self->log, "Too many participants %zu", target->participantCount)
+        return decodeResult;
+    }
+    if (decodeResult < 0) {
+        CLOG_C_SOFT_ERROR(&self->log, "step %08X could not be parsed (%d)", stepId, decodeResult)
+        return decodeResult;
+    }
+
+#if defined CLOG_LOG_ENABLE
+    for (size_t i = 0; i < target->participantCount; ++i) {
+        const TransmuteParticipantInput* participantInput = &target->participantInputs[i];
+        CLOG_C_VERBOSE(&self->log, "  participant %d octetCount: %zu", participantInput->participantId,
+                       participantInput->octetSize)
+    }
+#endif
+
+    self->updateMetrics.octetsParsed += octetCount;
+    self->updateMetrics.participantCount = target->participantCount;
+    if (self->measureUpdateTimings) {
+        self->updateMetrics.parseNs += assentClockNowNs() - parseStartNs;
+    }
+    traceSpan(self, AssentTraceEventTypeParse, parseStartNs, stepId, octetCount);
+
+    return 0;
+}
+
+/// A record is the AssentDecodedStep, followed by maxPlayers participant inputs and then the payloads.
+static AssentDecodedStep* recordStep(const Assent* self, uint8_t* record, uint8_t** outPayloads)
+{
+    AssentDecodedStep* decodedStep = (AssentDecodedStep*) (void*) record;
+    TransmuteInput* input = &decodedStep->input;
+    input->participantInputs = (TransmuteParticipantInput*) (void*) (record + sizeof(AssentDecodedStep));
+    *outPayloads = (uint8_t*) &input->participantInputs[self->maxPlayerCount];
+
+    return decodedStep;
+}
+
+/// Copies the payloads of the participant inputs into the record, so it does not point into memory that is reused.
+/// @return the number of payload octets, or -1 if they do not fit.
+static int copyPayloadsIntoRecord(const Assent* self, TransmuteInput* input, uint8_t* payloads)
+{
+    size_t payloadOctetCount = 0;
+
+    for (size_t i = 0; i < input->participantCount; ++i) {
+        TransmuteParticipantInput* participantInput = &input->participantInputs[i];
+        if (payloadOctetCount + participantInput->octetSize > self->decodedPayloadOctetCount) {
+            return -1;
+        }
+        if (participantInput->input != 0) {
+            tc_memcpy_octets(&payloads[payloadOctetCount], participantInput->input, participantInput->octetSize);
+            participantInput->input = &payloads[payloadOctetCount];
+        }
+        payloadOctetCount += participantInput->octetSize;
+    }
+
+    return (int) payloadOctetCount;
+}
+
+/// Decodes the step into its record, on the thread adding the step, so that assentUpdate() does not have to parse
+/// it. The payloads are copied into the record, since the step octets are reused once the step has been moved into
+/// the authoritative steps. Unless AssentSetup::storeDecodedSteps is set, a step that gets no record (it is too far
+/// ahead, or malformed) is parsed by assentUpdate() as usual.
+/// @return 0 if decoded, ASSENT_STEP_INGEST_DUPLICATE if the step already has a record,
+/// ASSENT_STEP_INGEST_TOO_FAR_AHEAD if its record is still used by an earlier step, ASSENT_STEP_INGEST_TOO_LARGE or
+/// -99 if the step is malformed.
+static int decodeAhead(Assent* self, StepId stepId, const uint8_t* octets, size_t octetCount)
+{
+    if (!self->useDecodeAhead) {
+        return 0;
+    }
+
+    if (octetCount > self->writeTempBufferSize) {
+        return ASSENT_STEP_INGEST_TOO_LARGE;
+    }
+
+    uint8_t* record;
+    const int reserveResult = assentStepIngestReserve(&self->decodedSteps, stepId, &record);
+    if (reserveResult != 0) {
+        return reserveResult;
+    }
+
+    uint8_t* payloads;
+    AssentDecodedStep* decodedStep = recordStep(self, record, &payloads);
+    TransmuteInput* input = &decodedStep->input;
+    if (decodeCombinedStep(self, octets, octetCount, input) < 0 || copyPayloadsIntoRecord(self, input, payloads) < 0) {
+        assentStepIngestCancel(&self->decodedSteps, stepId);
+        return -99;
+    }
+    decodedStep->octetsHash = mashMurmurHash3(octets, octetCount);
+
+    assentStepIngestCommit(&self->decodedSteps, stepId, octetCount, stepArrivalTimeNs(self));
+
+    return 0;
+}
+
+/// Stores the input as the record of the step, without serializing it, see AssentSetup::storeDecodedSteps.
+static int storeStepRecord(Assent* self, StepId stepId, const TransmuteInput* source)
+{
+    if (source->participantCount > self->maxPlayerCount) {
+        CLOG_C_NOTICE(&self->log, "step %08X has too many participants %zu", stepId, source->participantCount)
+        return -99;
+    }
+
+    uint8_t* record;
+    const int reserveResult = assentStepIngestReserve(&self->decodedSteps, stepId, &record);
+    if (reserveResult != 0) {
+        return reserveResult;
+    }
+
+    uint8_t* payloads;
+    AssentDecodedStep* decodedStep = recordStep(self, record, &payloads);
+    TransmuteInput* input = &decodedStep->input;
+    decodedStep->octetsHash = 0; // there are no octets, the record is the step
+    input->participantCount = source->participantCount;
+    tc_memcpy_octets(input->participantInputs, source->participantInputs,
+                     source->participantCount * sizeof(TransmuteParticipantInput));
+    const int payloadOctetCount = copyPayloadsIntoRecord(self, input, payloads);
+    if (payloadOctetCount < 0) {
+        assentStepIngestCancel(&self->decodedSteps, stepId);
+        return -2;
+    }
+
+    const size_t recordOctetCount = (size_t) (payloads - record) + (size_t) payloadOctetCount;
+    assentStepIngestCommit(&self->decodedSteps, stepId, recordOctetCount, stepArrivalTimeNs(self));
+
+    return 0;
+}
+
+/// Borrows the step `offset` steps after self->stepId. With AssentSetup::storeDecodedSteps it only has a record,
+/// and no combined step octets.
+/// @return the octet count of the step, zero or less if it has not been added.
+static int borrowStep(Assent* self, size_t offset, StepId* outStepId, const uint8_t** outOctets)
+{
+    if (self->storeDecodedSteps) {
+        const AssentStepIngestSlot* slot = assentStepIngestPeekAt(&self->decodedSteps, offset);
+        if (slot == 0) {
+            return 0;
+        }
+        *outStepId = (StepId) (self->stepId + offset);
+        *outOctets = 0;
+        return (int) slot->octetCount;
+    }
+
+    return assentStepsBorrow(&self->authoritativeSteps, offset, outStepId, outOctets, self->readTempBuffer,
+                             self->readTempBufferSize);
+}
+
+/// A record can have been decoded from another version of the step than the one that was stored, if the step was
+/// added again with other content after the first one was rejected (or the record did not fit at first).
+static bool isRecordOfStep(const Assent* self, const AssentStepIngestSlot* slot, const uint8_t* octets,
+                           size_t octetCount)
+{
+    if (self->storeDecodedSteps) {
+        return true;
+    }
+
+    const AssentDecodedStep* decodedStep = (const AssentDecodedStep*) (const void*) slot->octets;
+
+    return slot->octetCount == octetCount && decodedStep->octetsHash == mashMurmurHash3(octets, octetCount);
+}
+
+/// Sets target to the input of the step, using its decode-ahead record if it has one. The step is `offset` steps
+/// after self->stepId. participantInputs is where the participant inputs are parsed into otherwise.
+static int inputForStep(Assent* self, size_t offset, StepId stepId, const uint8_t* octets, size_t octetCount,
+                        TransmuteInput* target, TransmuteParticipantInput* participantInputs)
+{
+    if (self->useDecodeAhead) {
+        const AssentStepIngestSlot* slot = assentStepIngestPeekAt(&self->decodedSteps, offset);
+        if (slot != 0 && isRecordOfStep(self, slot, octets, octetCount)) {
+            *target = ((const AssentDecodedStep*) (const void*) slot->octets)->input;
+            if (self->storeDecodedSteps && self->measureStepLatency) {
+                AssentStepArrival* arrival = &self->stepArrivals[stepId % self->stepArrivalCapacity];
+                arrival->stepId = stepId;
+                arrival->arrivalTimeNs = slot->arrivalTimeNs;
+            }
+            self->updateMetrics.participantCount = target->participantCount;
+            self->updateMetrics.stepsPreDecoded++;
+            return 0;
+        }
+    }
+
+    target->participantInputs = participantInputs;
+
+    return parseCombinedStep(self, stepId, octets, octetCount, target);
+}
+
+/// Releases the consumed steps, and their records so they can be used for later steps.
+static void releaseSteps(Assent* self, size_t stepCount)
+{
+    if (!self->storeDecodedSteps) {
+        assentStepsRelease(&self->authoritativeSteps, stepCount);
+    }
+    if (self->useDecodeAhead) {
+        for (size_t i = 0; i < stepCount; ++i) {
+            assentStepIngestDrop(&self->decodedSteps);
+        }
+    }
+}
+
+/// Steps waiting to be ticked. With AssentSetup::storeDecodedSteps, the records up to the first missing step.
+static size_t authoritativeBacklog(const Assent* self)
+{
+    if (self->storeDecodedSteps) {
+        return assentStepIngestReadyCount(&self->decodedSteps);
+    }
+
+    return self->authoritativeSteps.stepsCount;
+}
+
+/// Asks the host for a snapshot to continue from. latestReceivedStepId is the last step waiting to be ticked.
+static void requestSnapshot(Assent* self, StepId latestReceivedStepId)
+{
+    self->isSnapshotRequestPending = true;
+    self->snapshotRequestedAtStepId = self->stepId;
+    TORNADO_CALLBACK_1(self->callbackObject, requestSnapshotFn, latestReceivedStepId);
+}
+
+/// The malformed step at self->stepId is kept, and the match stays stopped on it: skipping it would make this peer
+/// diverge from the ones that could parse it. Every update returns the parse error until a snapshot after the step
+/// is applied with assentApplySnapshot(). One is requested if requestSnapshotFn is set.
+static void stopAtMalformedStep(Assent* self, int parseResult)
+{
+    CLOG_C_SOFT_ERROR(&self->log, "step %08X is malformed (%d), stopping until a snapshot is applied", self->stepId,
+                      parseResult)
+    if (self->callbackObject.vtbl->requestSnapshotFn == 0 || self->isSnapshotRequestPending) {
+        return;
+    }
+
+    requestSnapshot(self, (StepId) (self->stepId + authoritativeBacklog(self) - 1));
+}
+
+/// Calls preTicksFn, measuring how long it takes if AssentSetup::measureUpdateTimings or tracing is set.
+static void callPreTicks(Assent* self)
+{
+    if (!self->measureUpdateTimings && !self->useTrace) {
+        TORNADO_CALLBACK(self->callbackObject, preTicksFn);
+        return;
+    }
+
+    const uint64_t startNs = assentClockNowNs();
+    TORNADO_CALLBACK(self->callbackObject, preTicksFn);
+    self->updateMetrics.preTicksNs += assentClockNowNs() - startNs;
+    traceSpan(self, AssentTraceEventTypePreTicks, startNs, self->stepId, 0);
+}
+
+/// Adds how long each of the steps waited between being added and the tick that consumes them to the histogram.
+static void recordStepLatencies(Assent* self, StepId firstStepId, size_t stepCount, uint64_t tickStartNs)
+{
+    if (!self->measureStepLatency) {
+        return;
+    }
+
+    for (size_t i = 0; i < stepCount; ++i) {
+        const StepId stepId = (StepId) (firstStepId + i);
+        const AssentStepArrival* arrival = &self->stepArrivals[stepId % self->stepArrivalCapacity];
+        if (arrival->stepId != stepId || arrival->arrivalTimeNs == 0 || arrival->arrivalTimeNs > tickStartNs) {
+            continue;
+        }
+        assentLatencyHistogramAdd(&self->stepLatencies, tickStartNs - arrival->arrivalTimeNs);
+    }
+}
+
+static void recordTickDuration(Assent* self, uint64_t durationNs)
+{
+    if (self->averageTickDurationNs == 0) {
+        self->averageTickDurationNs = durationNs;
+        return;
+    }
+    self->averageTickDurationNs = self->averageTickDurationNs - self->averageTickDurationNs / 8 + durationNs / 8;
+}
+
+/// Parses all steps available in this update (up to maxStepCount) and hands them to tickBatchFn in one call.
+/// All the steps are kept in the authoritative steps storage until tickBatchFn has returned. Only one step
+/// in a run can wrap around the end of the circular steps buffer, so readTempBuffer is enough as fallback.
+static int updateBatch(Assent* self, size_t maxStepCount, bool measureTicks, size_t* outStepsRun)
+{
+    size_t stepCount = 0;
+    int parseResult = 0;
+    bool isMissingSteps = false;
+
+    *outStepsRun = 0;
+
+    for (; stepCount < maxStepCount; ++stepCount) {
+        StepId outStepId;
+        const uint8_t* combinedStepOctets;
+        const int payloadOctetCount = borrowStep(self, stepCount, &outStepId, &combinedStepOctets);
+        if (payloadOctetCount <= 0) {
+            break;
+        }
+
+        const StepId expectedStepId = (StepId) (self->stepId + stepCount);
+        if (outStepId != expectedStepId) {
+            CLOG_C_SOFT_ERROR(&self->log, "steps buffer is missing steps. expected %04X but received %04X",
+                              expectedStepId, outStepId)
+            isMissingSteps = true;
+            break;
+        }
+
+        parseResult = inputForStep(self, stepCount, outStepId, combinedStepOctets, (size_t) payloadOctetCount,
+                                   &self->batchTransmuteInputs[stepCount],
+                                   &self->batchParticipantInputs[stepCount * self->maxPlayerCount]);
+        if (parseResult < 0) {
+            break;
+        }
+
+        hashConsumedStep(self, outStepId, combinedStepOctets, (size_t) payloadOctetCount);
+    }
+
+    if (stepCount > 0) {
+        callPreTicks(self);
+        const uint64_t tickStartNs = measureTicks ? assentClockNowNs() : 0;
+        recordStepLatencies(self, self->stepId, stepCount, tickStartNs);
+        TORNADO_CALLBACK_3(self->callbackObject, tickBatchFn, self->batchTransmuteInputs, stepCount, self->stepId);
+        if (measureTicks) {
+            const uint64_t tickNs = assentClockNowNs() - tickStartNs;
+            recordTickDuration(self, tickNs / stepCount);
+            self->updateMetrics.tickNs += tickNs;
+            traceSpan(self, AssentTraceEventTypeTick, tickStartNs, self->stepId, stepCount);
+        }
+        releaseSteps(self, stepCount);
+        self->stepId += (StepId) stepCount;
+        *outStepsRun = stepCount;
+        onAuthoritativeStepReached(self);
+    }
+
+    if (parseResult < 0) {
+        stopAtMalformedStep(self, parseResult);
+        return parseResult;
+    }
+
+    return isMissingSteps ? -1 : 0;
+}
+
+/// Ticks one step at a time, up to maxStepCount steps. If budgetNs is set, it stops before the next tick
+/// would (judging by the average tick duration) exceed the budget. At least one step is always ticked so that a
+/// too small budget can not stall the simulation completely.
+static int updateSingle(Assent* self, size_t maxStepCount, uint64_t budgetNs, size_t* outStepsRun)
 {
     StepId outStepId;
     bool hasCalledFirstTickThisUpdate = false;
+    const bool measureTicks = budgetNs != 0 || self->measureUpdateTimings || self->measureStepLatency ||
+                              self->useTrace;
+    const uint64_t startNs = measureTicks ? assentClockNowNs() : 0;
+    uint64_t nowNs = startNs;
+
+    *outStepsRun = 0;
+
+    for (size_t readCount = 0; readCount < maxStepCount; ++readCount) {
+        if (budgetNs != 0 && readCount > 0 && (nowNs - startNs) + self->averageTickDurationNs > budgetNs) {
+            break;
+        }
 
-    for (size_t readCount = 0; readCount < self->maxTicksPerRead; ++readCount) {
-        const int payloadOctetCount = nbsStepsRead(&self->authoritativeSteps, &outStepId, self->readTempBuffer,
-                                                   self->readTempBufferSize);
+        // The payloads in lastTransmuteInput point straight into the authoritative steps storage (or the decode-ahead
+        // record), so the step must not be released until tickFn has returned.
+        const uint8_t* combinedStepOctets;
+        const int payloadOctetCount = borrowStep(self, 0, &outStepId, &combinedStepOctets);
         if (payloadOctetCount <= 0) {
             break;
         }
 
         if (outStepId != self->stepId) {
-            CLOG_C_ERROR(&self->log, "internal error steps buffer is missing steps. expected %04X but received %04X",
-                         self->stepId, outStepId)
-            // return -1;
+            CLOG_C_SOFT_ERROR(&self->log, "steps buffer is missing steps. expected %04X but received %04X",
+                              self->stepId, outStepId)
+            return -1;
         }
 
-        NimbleStepsOutSerializeLocalParticipants participants;
-
         // CLOG_EXECUTE(uint64_t authoritativeStateHash = TORNADO_CALLBACK(self->callbackObject, hashFn);)
 
-        nbsStepsInSerializeStepsForParticipantsFromOctets(&participants, self->readTempBuffer,
-                                                          (size_t) payloadOctetCount);
+        const int parseResult = inputForStep(self, 0, outStepId, combinedStepOctets, (size_t) payloadOctetCount,
+                                             &self->lastTransmuteInput, self->lastParticipantInputs);
         // CLOG_C_VERBOSE(&self->log,
         //              "read authoritative step %08X (octetCount:%d hash:%04X) authoritative hash:%08" PRIX64,
-        //            outStepId, payloadOctetCount, mashMurmurHash3(self->readTempBuffer, (size_t) payloadOctetCount),
+        //            outStepId, payloadOctetCount, mashMurmurHash3(combinedStepOctets, (size_t) payloadOctetCount),
         //          authoritativeStateHash)
-
-#if defined CLOG_LOG_ENABLE
-        for (size_t i = 0; i < participants.participantCount; ++i) {
-            NimbleStepsOutSerializeLocalParticipant* participant = &participants.participants[i];
-            CLOG_C_VERBOSE(&self->log, "  participant %d octetCount: %zu", participant->participantId,
-                           participant->payloadCount);
+        if (parseResult < 0) {
+            stopAtMalformedStep(self, parseResult);
+            return parseResult;
         }
-#endif
 
-        if (participants.participantCount > self->maxPlayerCount) {
-            CLOG_C_SOFT_ERROR(&self->log, "Too many participants %zu", participants.participantCount)
-            return -99;
-        }
-        self->lastTransmuteInput.participantCount = participants.participantCount;
-        for (size_t i = 0; i < participants.participantCount; ++i) {
-            NimbleStepsOutSerializeLocalParticipant* participant = &participants.participants[i];
-            self->lastTransmuteInput.participantInputs[i].participantId = participant->participantId;
-            self->lastTransmuteInput.participantInputs[i].localPartyId = participant->localPartyId;
-            self->lastTransmuteInput.participantInputs[i].inputType = toTransmuteInput(participant->stepType);
-            self->lastTransmuteInput.participantInputs[i].input = participant->payload;
-            self->lastTransmuteInput.participantInputs[i].octetSize = participant->payloadCount;
-        }
+        hashConsumedStep(self, outStepId, combinedStepOctets, (size_t) payloadOctetCount);
 
         if (!hasCalledFirstTickThisUpdate) {
             hasCalledFirstTickThisUpdate = true;
-            TORNADO_CALLBACK(self->callbackObject, preTicksFn);
+            callPreTicks(self);
         }
 
+        const uint64_t tickStartNs = measureTicks ? assentClockNowNs() : 0;
+        recordStepLatencies(self, self->stepId, 1, tickStartNs);
         TORNADO_CALLBACK_2(self->callbackObject, tickFn, &self->lastTransmuteInput, self->stepId);
+        if (measureTicks) {
+            nowNs = assentClockNowNs();
+            recordTickDuration(self, nowNs - tickStartNs);
+            self->updateMetrics.tickNs += nowNs - tickStartNs;
+            traceSpan(self, AssentTraceEventTypeTick, tickStartNs, self->stepId, 1);
+        }
 
+        releaseSteps(self, 1);
         self->stepId++;
+        (*outStepsRun)++;
+        onAuthoritativeStepReached(self);
+    }
+
+    return 0;
+}
+
+/// Asks the host for a recent snapshot when the backlog is so large that simulating it would take too long.
+/// The backlog is still simulated while waiting for assentApplySnapshot(). If no snapshot has been applied after
+/// another threshold worth of steps, the request is repeated.
+static void requestSnapshotIfTooFarBehind(Assent* self)
+{
+    const size_t backlog = authoritativeBacklog(self);
+    if (self->skipToSnapshotBacklogThreshold == 0 || backlog <= self->skipToSnapshotBacklogThreshold) {
+        return;
+    }
+
+    if (self->isSnapshotRequestPending &&
+        self->stepId - self->snapshotRequestedAtStepId < self->skipToSnapshotBacklogThreshold) {
+        return;
     }
 
-    CLOG_C_VERBOSE(&self->log, "remaining authoritative steps after tick: %zu", self->authoritativeSteps.stepsCount)
+    const StepId latestReceivedStepId = (StepId) (self->stepId + backlog - 1);
+    CLOG_C_NOTICE(&self->log, "backlog of %zu steps is too large, requesting snapshot (latest received %04X)", backlog,
+                  latestReceivedStepId)
+
+    requestSnapshot(self, latestReceivedStepId);
+}
+
+/// Moves the steps in the reorder window that now follow the authoritative steps without a gap into them.
+static void releaseReorderedSteps(Assent* self)
+{
+    const uint8_t* octets;
+    size_t octetCount;
+
+    assentReorderWindowSkipTo(&self->reorderWindow, self->authoritativeSteps.expectedWriteId);
+    while (assentReorderWindowPeek(&self->reorderWindow, &octets, &octetCount)) {
+        if (nbsStepsWrite(&self->authoritativeSteps, self->reorderWindow.nextStepId, octets, octetCount) < 0) {
+            // the authoritative steps are full, try again after the next update
+            break;
+        }
+        assentReorderWindowSkipTo(&self->reorderWindow, self->authoritativeSteps.expectedWriteId);
+    }
+}
+
+/// Steps before stepId have been consumed, and the ones from stepId up to expectedWriteId are in the
+/// authoritative steps, so together with the reorder window bitmap a redundant step is found in O(1) without
+/// touching the steps storage.
+static int rejectRedundantStep(Assent* self, StepId stepId)
+{
+    if (stepId < self->stepId) {
+        self->staleStepCount++;
+        return ASSENT_ADD_STEP_STALE;
+    }
+
+    if (stepId < self->authoritativeSteps.expectedWriteId ||
+        (self->useReorderWindow && assentReorderWindowContains(&self->reorderWindow, stepId))) {
+        self->duplicateStepCount++;
+        return ASSENT_ADD_STEP_DUPLICATE;
+    }
 
     return 0;
 }
 
+/// Steps that arrive ahead of a missing step are held in the reorder window (if enabled) until the gap is filled.
+static int writeAuthoritativeStep(Assent* self, StepId stepId, const uint8_t* combinedAuthoritativeStep,
+                                  size_t octetCount, uint64_t arrivalTimeNs)
+{
+    const int rejectResult = rejectRedundantStep(self, stepId);
+    if (rejectResult != 0) {
+        return rejectResult;
+    }
+
+    if (self->measureStepLatency) {
+        AssentStepArrival* arrival = &self->stepArrivals[stepId % self->stepArrivalCapacity];
+        arrival->stepId = stepId;
+        arrival->arrivalTimeNs = arrivalTimeNs;
+    }
+
+    if (self->useReorderWindow && stepId > self->authoritativeSteps.expectedWriteId) {
+        return assentReorderWindowInsert(&self->reorderWindow, stepId, combinedAuthoritativeStep, octetCount);
+    }
+
+    const int result = nbsStepsWrite(&self->authoritativeSteps, stepId, combinedAuthoritativeStep, octetCount);
+    // CLOG_C_VERBOSE(&self->log, "assent authoritative steps total:%zu", self->authoritativeSteps.stepsCount)
+    if (self->useReorderWindow && result >= 0) {
+        releaseReorderedSteps(self);
+    }
+    return result;
+}
+
+/// Moves an ingested step into the authoritative steps.
+/// @return false if the authoritative steps are full, and the step has to stay in the ingest until the next update.
+static bool moveIngestedStep(Assent* self, StepId stepId, const uint8_t* octets, size_t octetCount,
+                             uint64_t arrivalTimeNs)
+{
+    const int result = writeAuthoritativeStep(self, stepId, octets, octetCount, arrivalTimeNs);
+    if (result >= 0) {
+        return true;
+    }
+
+    if (stepId != self->authoritativeSteps.expectedWriteId) {
+        CLOG_C_NOTICE(&self->log, "step %08X is too far ahead of %08X, it has to be resent", stepId,
+                      self->authoritativeSteps.expectedWriteId)
+        return true;
+    }
+
+    // the authoritative steps are full, steps that could never be stored are rejected when they are added
+    return false;
+}
+
+/// Moves the steps added by the ingest thread(s) into the authoritative steps. Only the simulation thread touches
+/// the authoritative steps, so they need no synchronization.
+static void drainIngestQueue(Assent* self)
+{
+    if (self->useConcurrentIngest) {
+        const AssentStepQueueSlot* slot;
+        while ((slot = assentStepQueuePeek(&self->ingestQueue)) != 0) {
+            if (!moveIngestedStep(self, slot->stepId, slot->octets, slot->octetCount, slot->arrivalTimeNs)) {
+                break;
+            }
+            assentStepQueuePop(&self->ingestQueue);
+        }
+        assentAtomicStore(&self->ingestExpectedStepId, self->authoritativeSteps.expectedWriteId);
+    } else if (self->useMultiProducerIngest) {
+        const AssentStepIngestSlot* slot;
+        while ((slot = assentStepIngestPeek(&self->multiProducerIngest)) != 0) {
+            const StepId stepId = self->multiProducerIngest.nextReadStepId;
+            if (!moveIngestedStep(self, stepId, slot->octets, slot->octetCount, slot->arrivalTimeNs)) {
+                break;
+            }
+            assentStepIngestPop(&self->multiProducerIngest);
+        }
+    }
+}
+
+static void beginUpdateMetrics(Assent* self)
+{
+    tc_mem_clear_type(&self->updateMetrics);
+    self->updateMetrics.backlogBefore = authoritativeBacklog(self);
+}
+
+static void endUpdateMetrics(Assent* self, size_t stepsRun)
+{
+    self->updateMetrics.stepsConsumed = stepsRun;
+    self->updateMetrics.backlogAfter = authoritativeBacklog(self);
+    assentMetricsCountersAdd(&self->metricsCounters, &self->updateMetrics);
+}
+
+/// Moves in the added steps and ticks up to maxStepCount of them. Without a budget, the tick-rate controller (if
+/// used) chooses maxStepCount from the backlog instead, and can choose to not tick at all in this update.
+static int updateSteps(Assent* self, size_t maxStepCount, uint64_t budgetNs, AssentUpdateResult* result)
+{
+    int updateResult = 0;
+    size_t stepsRun = 0;
+    const uint64_t updateStartNs = traceStartNs(self);
+    const StepId firstStepId = self->stepId;
+
+    drainIngestQueue(self);
+    if (self->useReorderWindow) {
+        releaseReorderedSteps(self);
+    }
+    beginUpdateMetrics(self);
+    requestSnapshotIfTooFarBehind(self);
+
+    if (self->useTickRateController && budgetNs == 0) {
+        maxStepCount = assentTickRateControllerChoose(&self->tickRateController, self->updateMetrics.backlogBefore);
+    }
+    self->updateMetrics.maxStepCount = maxStepCount;
+
+    if (maxStepCount == 0) {
+        // the tick-rate controller lets the backlog build up to targetBacklog
+    } else if (self->batchTransmuteInputs != 0) {
+        size_t batchStepCount = self->maxTicksPerRead;
+        if (budgetNs != 0 && self->averageTickDurationNs != 0) {
+            const uint64_t stepsInBudget = budgetNs / self->averageTickDurationNs;
+            batchStepCount = stepsInBudget < batchStepCount ? (size_t) stepsInBudget : batchStepCount;
+        }
+        if (batchStepCount > maxStepCount) {
+            batchStepCount = maxStepCount;
+        }
+        // end the run on the next hash or snapshot boundary, the state in the middle of a batch is not reachable
+        if (self->stateHashInterval != 0) {
+            const size_t stepsToBoundary = stepsToNextMultiple(self->stepId, self->stateHashInterval);
+            batchStepCount = stepsToBoundary < batchStepCount ? stepsToBoundary : batchStepCount;
+        }
+        if (self->snapshotInterval != 0) {
+            const size_t stepsToBoundary = stepsToNextMultiple(self->stepId, self->snapshotInterval);
+            batchStepCount = stepsToBoundary < batchStepCount ? stepsToBoundary : batchStepCount;
+        }
+        if (batchStepCount == 0) {
+            batchStepCount = 1;
+        }
+        const bool measureTicks = budgetNs != 0 || self->measureUpdateTimings || self->measureStepLatency ||
+                              self->useTrace;
+        updateResult = updateBatch(self, batchStepCount, measureTicks, &stepsRun);
+    } else {
+        updateResult = updateSingle(self, maxStepCount, budgetNs, &stepsRun);
+    }
+
+    endUpdateMetrics(self, stepsRun);
+    CLOG_C_VERBOSE(&self->log, "ticked %zu steps, remaining authoritative steps after tick: %zu", stepsRun,
+                   self->updateMetrics.backlogAfter)
+
+    traceSpan(self, AssentTraceEventTypeUpdate, updateStartNs, firstStepId, stepsRun);
+
+    if (result != 0) {
+        result->stepsRun = stepsRun;
+        result->stepsRemaining = self->updateMetrics.backlogAfter;
+    }
+
+    return updateResult;
+}
+
+int assentUpdate(Assent* self)
+{
+    return updateSteps(self, self->maxTicksPerRead, 0, 0);
+}
+
+/// Ticks as many authoritative steps as fits within budgetNs of wall-clock time, instead of a fixed
+/// maxTicksPerRead. The duration of each tick is measured to predict if the next one would exceed the budget.
+/// In batch mode (tickBatchFn) the run is sized up front from the average tick duration and capped
+/// by maxTicksPerRead.
+int assentUpdateWithBudget(Assent* self, uint64_t budgetNs, AssentUpdateResult* result)
+{
+    return updateSteps(self, SIZE_MAX, budgetNs, result);
+}
+
 static NimbleSerializeStepType toConnectState(TransmuteParticipantInputType inputType)
 {
     switch (inputType) {
@@ -141,8 +942,27 @@ static NimbleSerializeStepType toConnectState(TransmuteParticipantInputType inpu
     CLOG_ERROR("toConnectState() not a valid connect state in assent %u", inputType)
 }
 
+/// Adds the input of a step, serialized as for assentAddAuthoritativeStepRaw(), so a step that has already been
+/// received is dropped with ASSENT_ADD_STEP_DUPLICATE and one that has already been consumed with
+/// ASSENT_ADD_STEP_STALE. With AssentSetup::storeDecodedSteps set, the input is copied straight into the record
+/// of the step, skipping the serialize and parse round trip, which is useful for steps produced on the server itself
+/// (e.g. bots). Steps can then be added from any thread and in any order, as long as they are less than
+/// decodeAheadCapacity steps ahead. The records do not tell consumed steps apart from received ones, so both are
+/// then dropped with ASSENT_ADD_STEP_DUPLICATE.
 ssize_t assentAddAuthoritativeStep(Assent* self, const TransmuteInput* input, StepId tickId)
 {
+    if (self->storeDecodedSteps) {
+        const uint64_t startNs = traceStartNs(self);
+        const int result = storeStepRecord(self, tickId, input);
+        traceSpan(self, AssentTraceEventTypeIngest, startNs, tickId, input->participantCount);
+        return result;
+    }
+
+    if (input->participantCount > self->maxPlayerCount) {
+        CLOG_C_NOTICE(&self->log, "step %08X has too many participants %zu", tickId, input->participantCount)
+        return -99;
+    }
+
     NimbleStepsOutSerializeLocalParticipants data;
 
     for (size_t i = 0; i < input->participantCount; ++i) {
@@ -163,19 +983,401 @@ ssize_t assentAddAuthoritativeStep(Assent* self, const TransmuteInput* input, St
 
     data.participantCount = input->participantCount;
 
-    ssize_t octetCount = nbsStepsOutSerializeCombinedStep(&data, self->readTempBuffer, self->readTempBufferSize);
+    uint8_t* target;
+    size_t maxOctetCount;
+    const int reserveResult = assentReserveAuthoritativeStep(self, tickId, &target, &maxOctetCount);
+    if (reserveResult != 0) {
+        return reserveResult;
+    }
+
+    const ssize_t octetCount = nbsStepsOutSerializeCombinedStep(&data, target, maxOctetCount);
     if (octetCount < 0) {
-        CLOG_C_ERROR(&self->log, "assentAddAuthoritativeStep: could not serialize")
-        // return octetCount;
+        CLOG_C_SOFT_ERROR(&self->log, "assentAddAuthoritativeStep: could not serialize step %08X", tickId)
+        assentCancelAuthoritativeStep(self, tickId);
+        return octetCount;
+    }
+
+    return assentCommitAuthoritativeStep(self, tickId, (size_t) octetCount);
+}
+
+/// Reserves space for serializing a combined step into, to be followed by assentCommitAuthoritativeStep() or
+/// assentCancelAuthoritativeStep().
+/// With concurrent or multi-producer ingest the space is the ingest slot itself, so the step is never copied
+/// before it reaches the simulation thread. Otherwise it is a write buffer that is separate from the buffer
+/// assentUpdate reads steps into, so it is safe to add steps from within tickFn.
+/// @return 0 on success, ASSENT_STEP_INGEST_DUPLICATE if the step is a known duplicate, negative on error.
+int assentReserveAuthoritativeStep(Assent* self, StepId stepId, uint8_t** outOctets, size_t* outMaxOctetCount)
+{
+    if (self->useConcurrentIngest) {
+        *outOctets = assentStepQueueReserve(&self->ingestQueue);
+        *outMaxOctetCount = self->ingestQueue.maxOctetCount;
+        if (*outOctets == 0) {
+            CLOG_C_NOTICE(&self->log, "assentReserveAuthoritativeStep: ingest queue is full")
+            return -1;
+        }
+        return 0;
+    }
+
+    if (self->useMultiProducerIngest) {
+        *outMaxOctetCount = self->multiProducerIngest.maxOctetCount;
+        return assentStepIngestReserve(&self->multiProducerIngest, stepId, outOctets);
+    }
+
+    *outOctets = self->writeTempBuffer;
+    *outMaxOctetCount = self->writeTempBufferSize;
+
+    return 0;
+}
+
+/// Gives up the space from assentReserveAuthoritativeStep() without adding the step, e.g. when the step could not be
+/// serialized into it, so that the step can be added again.
+void assentCancelAuthoritativeStep(Assent* self, StepId stepId)
+{
+    if (self->useMultiProducerIngest) {
+        assentStepIngestCancel(&self->multiProducerIngest, stepId);
+    }
+    // the ingest queue slot and the write buffer are not claimed until the step is committed
+}
+
+/// Steps that can never be stored in the authoritative steps are rejected when they are added, so that they can not
+/// block the steps after them in the ingest.
+static bool isStorableOctetCount(const Assent* self, size_t octetCount)
+{
+    return octetCount != 0 && octetCount <= self->writeTempBufferSize;
+}
+
+/// The space handed out by the latest assentReserveAuthoritativeStep() for the StepId.
+static const uint8_t* reservedStepOctets(const Assent* self, StepId stepId)
+{
+    if (self->useConcurrentIngest) {
+        return self->ingestQueue.slots[self->ingestQueue.writeCount % self->ingestQueue.capacity].octets;
+    }
+
+    if (self->useMultiProducerIngest) {
+        return self->multiProducerIngest.slots[stepId % self->multiProducerIngest.capacity].octets;
+    }
+
+    return self->writeTempBuffer;
+}
+
+/// Adds the combined step serialized into the space from assentReserveAuthoritativeStep().
+/// The reservation is cancelled and -2 returned if octetCount is zero or larger than the reserved space.
+int assentCommitAuthoritativeStep(Assent* self, StepId stepId, size_t octetCount)
+{
+    const uint64_t startNs = traceStartNs(self);
+    int result = 0;
+
+    if (!isStorableOctetCount(self, octetCount)) {
+        CLOG_C_NOTICE(&self->log, "assentCommitAuthoritativeStep: step %08X has illegal octet count %zu", stepId,
+                      octetCount)
+        assentCancelAuthoritativeStep(self, stepId);
+        return -2;
     }
 
-    return assentAddAuthoritativeStepRaw(self, self->readTempBuffer, (size_t) octetCount, tickId);
+    const int decodeResult = decodeAhead(self, stepId, reservedStepOctets(self, stepId), octetCount);
+
+    if (self->storeDecodedSteps) {
+        result = decodeResult;
+    } else if (self->useConcurrentIngest) {
+        assentStepQueueCommit(&self->ingestQueue, stepId, octetCount, stepArrivalTimeNs(self));
+    } else if (self->useMultiProducerIngest) {
+        assentStepIngestCommit(&self->multiProducerIngest, stepId, octetCount, stepArrivalTimeNs(self));
+    } else {
+        result = writeAuthoritativeStep(self, stepId, self->writeTempBuffer, octetCount, stepArrivalTimeNs(self));
+    }
+
+    traceSpan(self, AssentTraceEventTypeIngest, startNs, stepId, octetCount);
+
+    return result;
 }
 
+/// Adds a serialized combined step. With AssentSetup::concurrentIngestCapacity set, this (and
+/// assentAddAuthoritativeStep) can be called from one ingest thread while another thread runs assentUpdate;
+/// the step is then handed over through a lock-free queue and moved into the authoritative steps on the next update.
+/// With AssentSetup::multiProducerIngestCapacity set, it can be called from any number of threads at once. Steps
+/// may then arrive in any order, and steps that were already added are dropped with ASSENT_STEP_INGEST_DUPLICATE.
+/// Otherwise steps that have already been received are dropped with ASSENT_ADD_STEP_DUPLICATE and steps that have
+/// already been consumed with ASSENT_ADD_STEP_STALE, see assentRedundantStepCounts().
+/// With AssentSetup::decodeAheadCapacity set, the step is also decoded here, so assentUpdate() only has to tick it.
+/// A step that is empty or larger than a combined step of maxPlayers participants is rejected with -2.
 int assentAddAuthoritativeStepRaw(Assent* self, const uint8_t* combinedAuthoritativeStep, size_t octetCount,
                                   StepId tickId)
 {
-    const int result = nbsStepsWrite(&self->authoritativeSteps, tickId, combinedAuthoritativeStep, octetCount);
-    // CLOG_C_VERBOSE(&self->log, "assent authoritative steps total:%zu", self->authoritativeSteps.stepsCount)
+    const uint64_t startNs = traceStartNs(self);
+    int result;
+
+    if (!isStorableOctetCount(self, octetCount)) {
+        CLOG_C_NOTICE(&self->log, "assentAddAuthoritativeStepRaw: step %08X has illegal octet count %zu", tickId,
+                      octetCount)
+        return -2;
+    }
+
+    const int decodeResult = decodeAhead(self, tickId, combinedAuthoritativeStep, octetCount);
+
+    if (self->storeDecodedSteps) {
+        result = decodeResult;
+    } else if (self->useConcurrentIngest) {
+        result = assentStepQueuePush(&self->ingestQueue, tickId, combinedAuthoritativeStep, octetCount,
+                                     stepArrivalTimeNs(self));
+    } else if (self->useMultiProducerIngest) {
+        result = assentStepIngestPush(&self->multiProducerIngest, tickId, combinedAuthoritativeStep, octetCount,
+                                      stepArrivalTimeNs(self));
+    } else {
+        result = writeAuthoritativeStep(self, tickId, combinedAuthoritativeStep, octetCount, stepArrivalTimeNs(self));
+    }
+
+    traceSpan(self, AssentTraceEventTypeIngest, startNs, tickId, octetCount);
+
     return result;
 }
+
+/// Tells if a range of steps starting at the StepId would leave a gap after the received steps that can not be held.
+/// Steps can arrive out of order up to the capacity of the reorder window, the multi-producer ingest or the
+/// decoded steps. With the ingest modes, it only uses what the calling thread can see.
+static bool startsTooFarAhead(const Assent* self, StepId firstStepId)
+{
+    if (self->storeDecodedSteps) {
+        return assentStepIngestIsTooFarAhead(&self->decodedSteps, firstStepId);
+    }
+
+    if (self->useMultiProducerIngest) {
+        return assentStepIngestIsTooFarAhead(&self->multiProducerIngest, firstStepId);
+    }
+
+    StepId expectedStepId = self->authoritativeSteps.expectedWriteId;
+    if (self->useConcurrentIngest) {
+        // the steps queued by this thread have not necessarily reached the authoritative steps yet
+        const StepId publishedStepId = (StepId) assentAtomicLoad(&self->ingestExpectedStepId);
+        expectedStepId = self->ingestQueue.nextStepId > publishedStepId ? self->ingestQueue.nextStepId
+                                                                        : publishedStepId;
+    }
+
+    const size_t maxAheadCount = self->useReorderWindow ? self->reorderWindow.capacity - 1 : 0;
+
+    return firstStepId > expectedStepId + maxAheadCount;
+}
+
+/// Adds stepCount consecutive serialized combined steps starting at firstStepId. The steps are packed back to back
+/// in combinedAuthoritativeSteps, with the octet count of each step in octetCounts. The whole range is validated
+/// once up front, and steps that are already stored are skipped, so a datagram carrying several steps needs a
+/// single call. With AssentSetup::concurrentIngestCapacity, duplicates are only found when assentUpdate() moves the
+/// steps out of the queue, so they are counted as added here.
+/// @return the number of steps added, -1 if the range leaves a gap after the received steps, -2 if a step is too
+/// large.
+int assentAddAuthoritativeStepsRaw(Assent* self, StepId firstStepId, const uint8_t* combinedAuthoritativeSteps,
+                                   const size_t* octetCounts, size_t stepCount)
+{
+    const uint64_t startNs = traceStartNs(self);
+    size_t totalOctetCount = 0;
+
+    for (size_t i = 0; i < stepCount; ++i) {
+        totalOctetCount += octetCounts[i];
+        if (!isStorableOctetCount(self, octetCounts[i])) {
+            CLOG_C_NOTICE(&self->log, "assentAddAuthoritativeStepsRaw: step %08X has illegal octet count %zu",
+                          firstStepId + (StepId) i, octetCounts[i])
+            return -2;
+        }
+    }
+
+    const uint8_t* octets = combinedAuthoritativeSteps;
+    const uint64_t arrivalTimeNs = stepArrivalTimeNs(self);
+    int addedCount = 0;
+
+    if (startsTooFarAhead(self, firstStepId)) {
+        CLOG_C_NOTICE(&self->log, "assentAddAuthoritativeStepsRaw: steps starting at %08X leave a gap", firstStepId)
+        return -1;
+    }
+
+    for (size_t index = 0; index < stepCount; ++index) {
+        const StepId stepId = firstStepId + (StepId) index;
+        int result = decodeAhead(self, stepId, octets, octetCounts[index]);
+        if (self->storeDecodedSteps) {
+            // the record is all there is
+        } else if (self->useConcurrentIngest) {
+            result = assentStepQueuePush(&self->ingestQueue, stepId, octets, octetCounts[index], arrivalTimeNs);
+        } else if (self->useMultiProducerIngest) {
+            result = assentStepIngestPush(&self->multiProducerIngest, stepId, octets, octetCounts[index],
+                                          arrivalTimeNs);
+        } else {
+            result = writeAuthoritativeStep(self, stepId, octets, octetCounts[index], arrivalTimeNs);
+        }
+        if (result < 0) {
+            // no room for the rest, they have to be resent
+            break;
+        }
+        if (result == 0) {
+            addedCount++;
+        }
+        octets += octetCounts[index];
+    }
+
+    traceSpan(self, AssentTraceEventTypeIngest, startNs, firstStepId, totalOctetCount);
+
+    return addedCount;
+}
+
+/// Gets what the latest assentUpdate() or assentUpdateWithBudget() did. Only valid on the thread calling them.
+const AssentUpdateMetrics* assentLastUpdateMetrics(const Assent* self)
+{
+    return &self->updateMetrics;
+}
+
+/// Gets the totals of all updates so far. Can be called from any thread, e.g. to feed a dashboard.
+void assentMetricsTotals(const Assent* self, AssentMetricsTotals* target)
+{
+    assentMetricsCountersRead(&self->metricsCounters, target);
+}
+
+/// Gets the percentiles of how long authoritative steps waited from being added until the tick that consumed
+/// them (see AssentSetup::measureStepLatency). Can be called from any thread.
+void assentStepLatency(const Assent* self, AssentLatencySummary* target)
+{
+    assentLatencyHistogramSummarize(&self->stepLatencies, target);
+}
+
+/// Starts over the step latency measurements, e.g. for a new match. Can be called from any thread.
+void assentResetStepLatency(Assent* self)
+{
+    assentLatencyHistogramReset(&self->stepLatencies);
+}
+
+/// Writes the latest update, parse, preTicksFn, tick and ingest spans as Chrome trace-event JSON
+/// (see AssentSetup::traceEventCapacity). Can be called from any thread.
+/// @return the number of octets written, or -1 if tracing is not enabled or target is too small.
+int assentWriteTrace(const Assent* self, char* target, size_t maxTargetOctetSize)
+{
+    if (!self->useTrace) {
+        return -1;
+    }
+
+    return assentTraceWriteChromeJson(&self->trace, target, maxTargetOctetSize);
+}
+
+/// Gets how many redundant steps have been rejected, either because they had already been received
+/// (duplicateCount) or already been consumed (staleCount). Duplicates rejected by the multi-producer ingest are
+/// counted as duplicates, since they are rejected before it is known if they have been consumed.
+void assentRedundantStepCounts(const Assent* self, uint64_t* outDuplicateCount, uint64_t* outStaleCount)
+{
+    *outDuplicateCount = self->duplicateStepCount;
+    if (self->useMultiProducerIngest) {
+        *outDuplicateCount += assentAtomicLoad(&self->multiProducerIngest.duplicateCount);
+    }
+    if (self->storeDecodedSteps) {
+        *outDuplicateCount += assentAtomicLoad(&self->decodedSteps.duplicateCount);
+    }
+    *outStaleCount = self->staleStepCount;
+}
+
+/// Lists the StepIds that are missing before the latest step held in the reorder window
+/// (see AssentSetup::reorderWindowCapacity), so the transport can ask for them to be resent early.
+/// @return the number of StepIds written to outStepIds.
+size_t assentMissingSteps(const Assent* self, StepId* outStepIds, size_t maxCount)
+{
+    if (!self->useReorderWindow) {
+        return 0;
+    }
+
+    return assentReorderWindowMissing(&self->reorderWindow, outStepIds, maxCount);
+}
+
+/// Looks up the authoritative state hash recorded for a StepId (see AssentSetup::stateHashInterval),
+/// so it can be compared with the hash another peer or the server reported for the same step.
+/// @return 0 if found, -1 if the step was not hashed or has fallen out of the history.
+int assentStateHash(const Assent* self, StepId stepId, uint64_t* outHash)
+{
+    return assentHashRingFind(&self->stateHashes, stepId, outHash);
+}
+
+/// Looks up the rolling hash of all the steps consumed up to and including the StepId
+/// (see AssentSetup::inputHashHistoryCount). If two peers agree on it, any difference in their authoritative state
+/// must come from non-determinism in the simulation, not from the steps they received.
+/// @return 0 if found, -1 if the step has not been consumed yet or has fallen out of the history.
+int assentInputHash(const Assent* self, StepId stepId, uint64_t* outHash)
+{
+    return assentHashRingFind(&self->inputHashes, stepId, outHash);
+}
+
+/// Gets the digest of the consumed steps in the aligned range [firstStepId, firstStepId + 2^level), see
+/// AssentSetup::stepTreeLeafCount. Comparing digests top-down with another peer finds the first divergent
+/// StepId in O(log n) exchanges.
+/// @return 0 if found, -1 if the range is not aligned, not fully consumed or has fallen out of the tree.
+int assentStepRangeDigest(const Assent* self, size_t level, StepId firstStepId, uint64_t* outDigest)
+{
+    return assentStepTreeDigest(&self->stepTree, level, firstStepId, outDigest);
+}
+
+/// Gets the latest authoritative state snapshot taken at or before the StepId (see AssentSetup::snapshotInterval),
+/// e.g. for a late joiner or a desynced client to resume from. Incremental snapshots are rebuilt into a complete
+/// state. The state octets are owned by Assent and are only valid until the next call.
+/// @return 0 if found, -1 if there is no snapshot old enough that can be restored.
+int assentSnapshot(Assent* self, StepId stepId, TransmuteState* outState, StepId* outStepId)
+{
+    const AssentSnapshot* snapshot = assentSnapshotsFindAtOrBefore(&self->snapshots, stepId);
+    if (snapshot == 0) {
+        return -1;
+    }
+
+    const uint8_t* stateOctets;
+    size_t stateOctetCount;
+    if (assentSnapshotsRestore(&self->snapshots, snapshot, &stateOctets, &stateOctetCount) < 0) {
+        return -1;
+    }
+
+    outState->state = stateOctets;
+    outState->octetSize = stateOctetCount;
+    *outStepId = snapshot->stepId;
+
+    return 0;
+}
+
+/// Reports that the application changed the serialized state in the octet range, when
+/// AssentSetup::snapshotDirtyTracking is AssentSnapshotDirtyTrackingReportedBlocks.
+void assentSnapshotMarkDirty(Assent* self, size_t octetOffset, size_t octetCount)
+{
+    assentSnapshotsMarkDirty(&self->snapshots, octetOffset, octetCount);
+}
+
+/// Re-initializes the authoritative state from a snapshot, typically received from the host after
+/// requestSnapshotFn has been called. Steps before the snapshot StepId are dropped from the authoritative steps
+/// and the simulation continues from the snapshot, so recovery time does not depend on how far behind it was.
+void assentApplySnapshot(Assent* self, TransmuteState state, StepId stepId)
+{
+    CLOG_C_DEBUG(&self->log, "applying snapshot %04X (octetSize:%zu), skipping from %04X", stepId, state.octetSize,
+                 self->stepId)
+
+    if (stepId < self->stepId) {
+        CLOG_C_SOFT_ERROR(&self->log, "snapshot %04X is older than the authoritative state %04X", stepId,
+                          self->stepId)
+        return;
+    }
+
+    const size_t stepsToSkip = stepId - self->stepId;
+    if (stepsToSkip >= self->authoritativeSteps.stepsCount) {
+        nbsStepsReInit(&self->authoritativeSteps, stepId);
+        assentAtomicStore(&self->ingestExpectedStepId, stepId);
+        if (self->useMultiProducerIngest) {
+            assentStepIngestSkipTo(&self->multiProducerIngest, stepId);
+        }
+        if (self->useReorderWindow) {
+            releaseReorderedSteps(self);
+        }
+    } else {
+        assentStepsRelease(&self->authoritativeSteps, stepsToSkip);
+    }
+
+    if (self->useDecodeAhead) {
+        assentStepIngestSkipTo(&self->decodedSteps, stepId);
+    }
+
+    TORNADO_CALLBACK_2(self->callbackObject, deserializeFn, &state, stepId);
+    self->stepId = stepId;
+    self->isSnapshotRequestPending = false;
+
+    // the skipped steps were never consumed, so the input hashes can not be continued
+    self->inputHash = 0;
+    assentHashRingClear(&self->inputHashes);
+    assentStepTreeClear(&self->stepTree);
+    self->snapshots.canWriteDelta = false;
+
+    onAuthoritativeStepReached(self);
+}
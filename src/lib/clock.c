@@ -0,0 +1,40 @@
+/*---------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved.
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------*/
+#if defined TORNADO_OS_WINDOWS
+#include <windows.h>
+#elif defined TORNADO_OS_MACOS
+#include <mach/mach_time.h>
+#else
+#define _POSIX_C_SOURCE 199309L
+#include <time.h>
+#endif
+
+#include <assent/clock.h>
+
+/// Monotonic time in nanoseconds, only meaningful as a difference between two calls.
+uint64_t assentClockNowNs(void)
+{
+#if defined TORNADO_OS_WINDOWS
+    static LARGE_INTEGER frequency;
+    if (frequency.QuadPart == 0) {
+        QueryPerformanceFrequency(&frequency);
+    }
+    LARGE_INTEGER counter;
+    QueryPerformanceCounter(&counter);
+    const uint64_t ticks = (uint64_t) counter.QuadPart;
+    const uint64_t ticksPerSecond = (uint64_t) frequency.QuadPart;
+    return (ticks / ticksPerSecond) * 1000000000ULL + (ticks % ticksPerSecond) * 1000000000ULL / ticksPerSecond;
+#elif defined TORNADO_OS_MACOS
+    static mach_timebase_info_data_t timebase;
+    if (timebase.denom == 0) {
+        mach_timebase_info(&timebase);
+    }
+    return mach_absolute_time() * timebase.numer / timebase.denom;
+#else
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * 1000000000ULL + (uint64_t) now.tv_nsec;
+#endif
+}
@@ -0,0 +1,78 @@
+/*---------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved.
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------*/
+#include <assent/hash_ring.h>
+#include <imprint/allocator.h>
+
+void assentHashRingInit(AssentHashRing* self, struct ImprintAllocator* allocator, size_t capacity)
+{
+    self->capacity = capacity;
+    self->entries = capacity == 0 ? 0 : IMPRINT_ALLOC_TYPE_COUNT(allocator, AssentStepHash, capacity);
+    assentHashRingClear(self);
+}
+
+void assentHashRingClear(AssentHashRing* self)
+{
+    self->headIndex = 0;
+    self->count = 0;
+}
+
+/// Adds a hash, overwriting the oldest one if the ring is full.
+/// Hashes must be added in increasing StepId order.
+void assentHashRingAdd(AssentHashRing* self, StepId stepId, uint64_t hash)
+{
+    if (self->capacity == 0) {
+        return;
+    }
+
+    AssentStepHash* entry = &self->entries[self->headIndex];
+    entry->stepId = stepId;
+    entry->hash = hash;
+
+    self->headIndex = (self->headIndex + 1) % self->capacity;
+    if (self->count < self->capacity) {
+        self->count++;
+    }
+}
+
+/// @return 0 if a hash for the StepId was found, -1 if it was never added or has been overwritten.
+int assentHashRingFind(const AssentHashRing* self, StepId stepId, uint64_t* outHash)
+{
+    if (self->count == 0) {
+        return -1;
+    }
+
+    // Fast path for rings that have a hash for every step
+    const AssentStepHash* latest = &self->entries[(self->headIndex + self->capacity - 1) % self->capacity];
+    if (stepId <= latest->stepId && latest->stepId - stepId < self->count) {
+        const size_t index = (self->headIndex + self->capacity - 1 - (latest->stepId - stepId)) % self->capacity;
+        if (self->entries[index].stepId == stepId) {
+            *outHash = self->entries[index].hash;
+            return 0;
+        }
+    }
+
+    for (size_t i = 0; i < self->count; ++i) {
+        const size_t index = (self->headIndex + self->capacity - 1 - i) % self->capacity;
+        const AssentStepHash* entry = &self->entries[index];
+        if (entry->stepId == stepId) {
+            *outHash = entry->hash;
+            return 0;
+        }
+        if (entry->stepId < stepId) {
+            break;
+        }
+    }
+
+    return -1;
+}
+
+const AssentStepHash* assentHashRingLatest(const AssentHashRing* self)
+{
+    if (self->count == 0) {
+        return 0;
+    }
+
+    return &self->entries[(self->headIndex + self->capacity - 1) % self->capacity];
+}
@@ -0,0 +1,288 @@
+/*---------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved.
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------*/
+#include <assent/clock.h>
+#include <assent/host.h>
+#include <clog/clog.h>
+#include <imprint/allocator.h>
+#include <tiny-libc/tiny_libc.h>
+
+#define ASSENT_HOST_MATCH_IDLE (0U)
+#define ASSENT_HOST_MATCH_QUEUED (1U)
+#define ASSENT_HOST_MATCH_RUNNING (2U)
+#define ASSENT_HOST_MATCH_RUNNING_READY (3U) // steps were added while running, run again
+
+/// A match is in at most one deque or in the ready queue at a time, so none of them can overflow.
+void assentHostInit(AssentHost* self, struct ImprintAllocator* allocator, size_t matchCapacity, size_t workerCount,
+                    AssentHostScheduling scheduling)
+{
+    self->scheduling = scheduling;
+    self->matchCapacity = matchCapacity;
+    self->matches = IMPRINT_CALLOC_TYPE_COUNT(allocator, AssentHostMatch, matchCapacity);
+    self->matchCount = 0;
+    self->workerCount = workerCount;
+    self->workers = IMPRINT_CALLOC_TYPE_COUNT(allocator, AssentHostWorker, workerCount);
+    for (size_t i = 0; i < workerCount; ++i) {
+        assentWorkDequeInit(&self->workers[i].deque, allocator, matchCapacity);
+    }
+    assentReadyQueueInit(&self->readyQueue, allocator, matchCapacity);
+}
+
+/// Adds an initialized Assent. Its steps must be added through the concurrent or multi-producer ingest
+/// (AssentSetup::concurrentIngestCapacity or multiProducerIngestCapacity) or be stored decoded
+/// (AssentSetup::storeDecodedSteps), since they are added on other threads than the workers. With concurrent ingest
+/// the steps of the match must all be added from the same thread. Only one thread may add matches.
+/// @param policy how urgent the match is, only used with AssentHostSchedulingEarliestDeadline. Can be NULL.
+/// @return the index of the match, or -1 if the host is full.
+int assentHostAddMatch(AssentHost* self, Assent* assent, const AssentHostMatchPolicy* policy)
+{
+    CLOG_ASSERT(assent->useConcurrentIngest || assent->useMultiProducerIngest || assent->storeDecodedSteps,
+                "matches in a host must use concurrent or multi-producer ingest, or store decoded steps")
+
+    const uint64_t matchIndex = self->matchCount;
+    if (matchIndex >= self->matchCapacity) {
+        return -1;
+    }
+
+    AssentHostMatch* match = &self->matches[matchIndex];
+    match->assent = assent;
+    if (policy != 0) {
+        match->policy = *policy;
+    } else {
+        tc_mem_clear_type(&match->policy);
+    }
+    assentAtomicStore(&match->backlog, 0);
+    assentAtomicStore(&match->averageTickDurationNs, 0);
+    assentAtomicStore(&match->missedDeadlineCount, 0);
+    assentAtomicStore(&match->state, ASSENT_HOST_MATCH_IDLE);
+    assentAtomicStore(&self->matchCount, matchIndex + 1);
+
+    return (int) matchIndex;
+}
+
+/// Any thread. Schedules the match for an update, unless it is already scheduled. With
+/// AssentSetup::concurrentIngestCapacity, only one thread may add steps to the match (and call this).
+void assentHostMatchReady(AssentHost* self, size_t matchIndex)
+{
+    AssentHostMatch* match = &self->matches[matchIndex];
+
+    // the added steps must be visible before the state is read, or a worker that just started could miss them
+    assentAtomicFence();
+    uint64_t state = assentAtomicLoad(&match->state);
+    const uint64_t nowNs = assentClockNowNs();
+
+    for (;;) {
+        if (state == ASSENT_HOST_MATCH_IDLE) {
+            // a producer that loses the race below can overwrite it with a slightly later time, which only makes
+            // the match look a little less urgent
+            assentAtomicStore(&match->readySinceNs, nowNs);
+        }
+        if (state == ASSENT_HOST_MATCH_QUEUED || state == ASSENT_HOST_MATCH_RUNNING_READY) {
+            return;
+        }
+        const uint64_t newState = state == ASSENT_HOST_MATCH_IDLE ? ASSENT_HOST_MATCH_QUEUED
+                                                                  : ASSENT_HOST_MATCH_RUNNING_READY;
+        if (assentAtomicCompareExchange(&match->state, &state, newState)) {
+            break;
+        }
+    }
+
+    if (state == ASSENT_HOST_MATCH_IDLE && self->scheduling == AssentHostSchedulingWorkStealing) {
+        assentReadyQueueEnqueue(&self->readyQueue, matchIndex);
+    }
+}
+
+/// Any thread, but with AssentSetup::concurrentIngestCapacity only one thread per match, since its ingest queue has a
+/// single producer. Adds the step to the match and schedules it.
+int assentHostAddAuthoritativeStepRaw(AssentHost* self, size_t matchIndex, const uint8_t* combinedAuthoritativeStep,
+                                      size_t octetCount, StepId stepId)
+{
+    const int result = assentAddAuthoritativeStepRaw(self->matches[matchIndex].assent, combinedAuthoritativeStep,
+                                                     octetCount, stepId);
+    if (result == 0) {
+        assentHostMatchReady(self, matchIndex);
+    }
+
+    return result;
+}
+
+typedef struct DeadlineCandidate {
+    bool hasWaitedTooLong;
+    bool isOverdue;
+    uint32_t priority;
+    uint64_t deadlineNs;
+    uint64_t readySinceNs;
+} DeadlineCandidate;
+
+/// Matches that have waited longer than their maxWaitNs go first, the longest waiting first, so no match starves.
+/// Then overdue matches by priority, so the important matches keep their latency when the host is overloaded.
+/// Otherwise, the earliest deadline.
+static bool isMoreUrgent(const DeadlineCandidate* a, const DeadlineCandidate* b)
+{
+    if (a->hasWaitedTooLong != b->hasWaitedTooLong) {
+        return a->hasWaitedTooLong;
+    }
+    if (a->hasWaitedTooLong) {
+        return a->readySinceNs < b->readySinceNs;
+    }
+    if (a->isOverdue != b->isOverdue) {
+        return a->isOverdue;
+    }
+    if (a->isOverdue && a->priority != b->priority) {
+        return a->priority > b->priority;
+    }
+
+    return a->deadlineNs < b->deadlineNs;
+}
+
+/// The deadline is when the oldest waiting step should have been ticked, minus the time it takes to tick the backlog.
+static void deadlineCandidate(const AssentHostMatch* match, uint64_t nowNs, DeadlineCandidate* candidate)
+{
+    const AssentHostMatchPolicy* policy = &match->policy;
+    const uint64_t readySinceNs = assentAtomicLoad(&match->readySinceNs);
+    const uint64_t workNs = assentAtomicLoad(&match->backlog) * assentAtomicLoad(&match->averageTickDurationNs);
+    const uint64_t targetNs = readySinceNs + policy->latencyTargetNs;
+
+    candidate->readySinceNs = readySinceNs;
+    candidate->deadlineNs = targetNs > workNs ? targetNs - workNs : 0;
+    candidate->isOverdue = candidate->deadlineNs <= nowNs;
+    candidate->hasWaitedTooLong = policy->maxWaitNs != 0 && nowNs > readySinceNs &&
+                                  nowNs - readySinceNs >= policy->maxWaitNs;
+    candidate->priority = policy->priority;
+}
+
+/// Scans all matches for the most urgent queued one and claims it. A linear scan is cheap compared to an update,
+/// even with hundreds of matches, and any worker can take any match, so no stealing is needed. See AssentHost for
+/// how it scales.
+static bool findMostUrgentMatch(AssentHost* self, uint64_t* outMatchIndex)
+{
+    const size_t matchCount = (size_t) assentAtomicLoad(&self->matchCount);
+
+    for (;;) {
+        const uint64_t nowNs = assentClockNowNs();
+        DeadlineCandidate best;
+        size_t bestIndex = matchCount;
+
+        for (size_t i = 0; i < matchCount; ++i) {
+            const AssentHostMatch* match = &self->matches[i];
+            if (assentAtomicLoad(&match->state) != ASSENT_HOST_MATCH_QUEUED) {
+                continue;
+            }
+            DeadlineCandidate candidate;
+            deadlineCandidate(match, nowNs, &candidate);
+            if (bestIndex == matchCount || isMoreUrgent(&candidate, &best)) {
+                best = candidate;
+                bestIndex = i;
+            }
+        }
+
+        if (bestIndex == matchCount) {
+            return false;
+        }
+
+        AssentHostMatch* match = &self->matches[bestIndex];
+        uint64_t state = ASSENT_HOST_MATCH_QUEUED;
+        if (assentAtomicCompareExchange(&match->state, &state, ASSENT_HOST_MATCH_RUNNING)) {
+            if (best.deadlineNs < nowNs) {
+                assentAtomicFetchAdd(&match->missedDeadlineCount, 1);
+            }
+            *outMatchIndex = bestIndex;
+            return true;
+        }
+        // another worker claimed it first, look again
+    }
+}
+
+/// With work stealing, a worker takes the matches in its own deque oldest first, and after each of them it gives
+/// the matches that just became ready a turn, so a match with a large backlog can not monopolize the worker.
+static bool findReadyMatch(AssentHost* self, size_t workerIndex, uint64_t* outMatchIndex)
+{
+    if (self->scheduling == AssentHostSchedulingEarliestDeadline) {
+        return findMostUrgentMatch(self, outMatchIndex);
+    }
+
+    AssentHostWorker* worker = &self->workers[workerIndex];
+
+    if (worker->hasRunOwnMatch && assentReadyQueueDequeue(&self->readyQueue, outMatchIndex)) {
+        worker->hasRunOwnMatch = false;
+        return true;
+    }
+
+    if (assentWorkDequeSteal(&worker->deque, outMatchIndex)) {
+        worker->hasRunOwnMatch = true;
+        return true;
+    }
+
+    worker->hasRunOwnMatch = false;
+    if (assentReadyQueueDequeue(&self->readyQueue, outMatchIndex)) {
+        return true;
+    }
+
+    for (size_t i = 1; i < self->workerCount; ++i) {
+        AssentHostWorker* victim = &self->workers[(workerIndex + i) % self->workerCount];
+        if (assentWorkDequeSteal(&victim->deque, outMatchIndex)) {
+            assentAtomicFetchAdd(&worker->stealCount, 1);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/// Updates the match. If it still has steps to catch up on, or steps were added while it ran, it is queued
+/// again, at the end of the deque of this worker when work stealing.
+static void runMatch(AssentHost* self, AssentHostWorker* worker, size_t matchIndex)
+{
+    AssentHostMatch* match = &self->matches[matchIndex];
+    const uint64_t startNs = assentClockNowNs();
+
+    assentAtomicStore(&match->state, ASSENT_HOST_MATCH_RUNNING);
+    assentAtomicFence();
+
+    if (match->policy.updateBudgetNs != 0) {
+        AssentUpdateResult result;
+        assentUpdateWithBudget(match->assent, match->policy.updateBudgetNs, &result);
+    } else {
+        assentUpdate(match->assent);
+    }
+    assentAtomicFetchAdd(&worker->updateCount, 1);
+
+    const AssentUpdateMetrics* metrics = assentLastUpdateMetrics(match->assent);
+    assentAtomicStore(&match->backlog, metrics->backlogAfter);
+    assentAtomicStore(&match->averageTickDurationNs, match->assent->averageTickDurationNs);
+
+    const bool hasMoreSteps = metrics->stepsConsumed > 0 && metrics->backlogAfter > 0;
+    uint64_t state = ASSENT_HOST_MATCH_RUNNING;
+    if (!hasMoreSteps && assentAtomicCompareExchange(&match->state, &state, ASSENT_HOST_MATCH_IDLE)) {
+        return;
+    }
+
+    if (!hasMoreSteps) {
+        // only steps added while running are waiting, the older ones were ticked
+        assentAtomicStore(&match->readySinceNs, startNs);
+    }
+    assentAtomicStore(&match->state, ASSENT_HOST_MATCH_QUEUED);
+    if (self->scheduling == AssentHostSchedulingWorkStealing) {
+        assentWorkDequePush(&worker->deque, matchIndex);
+    }
+}
+
+/// Called repeatedly by the thread of each worker. Updates ready matches until there are none left or
+/// maxUpdateCount updates have been run.
+/// @return the number of updates run, if zero the thread can sleep a while before calling it again.
+size_t assentHostWork(AssentHost* self, size_t workerIndex, size_t maxUpdateCount)
+{
+    AssentHostWorker* worker = &self->workers[workerIndex];
+    size_t updateCount = 0;
+    uint64_t matchIndex;
+
+    for (; updateCount < maxUpdateCount; ++updateCount) {
+        if (!findReadyMatch(self, workerIndex, &matchIndex)) {
+            break;
+        }
+        runMatch(self, worker, (size_t) matchIndex);
+    }
+
+    return updateCount;
+}
@@ -0,0 +1,107 @@
+/*---------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved.
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------*/
+#include <assent/latency_histogram.h>
+
+static size_t mostSignificantBit(uint64_t value)
+{
+    size_t bit = 0;
+
+    for (size_t shift = 32; shift > 0; shift /= 2) {
+        if (value >> shift) {
+            value >>= shift;
+            bit += shift;
+        }
+    }
+
+    return bit;
+}
+
+/// Values below four get their own bucket, above that the two bits below the most significant bit select
+/// one of four buckets for each power of two.
+static size_t bucketIndex(uint64_t value)
+{
+    if (value < 4) {
+        return (size_t) value;
+    }
+
+    const size_t msb = mostSignificantBit(value);
+    const size_t subBucket = (size_t) (value >> (msb - 2)) & 3U;
+
+    return (msb - 1) * 4 + subBucket;
+}
+
+static uint64_t bucketUpperBound(size_t index)
+{
+    if (index < 4) {
+        return index;
+    }
+
+    const size_t msb = index / 4 + 1;
+    const uint64_t lowerBound = (uint64_t) (4 + index % 4) << (msb - 2);
+
+    return lowerBound + (((uint64_t) 1U << (msb - 2)) - 1);
+}
+
+void assentLatencyHistogramInit(AssentLatencyHistogram* self)
+{
+    assentLatencyHistogramReset(self);
+}
+
+void assentLatencyHistogramAdd(AssentLatencyHistogram* self, uint64_t durationNs)
+{
+    assentAtomicFetchAdd(&self->buckets[bucketIndex(durationNs)], 1);
+}
+
+/// Percentiles are reported as the upper bound of the bucket they fall in.
+void assentLatencyHistogramSummarize(const AssentLatencyHistogram* self, AssentLatencySummary* target)
+{
+    uint64_t counts[ASSENT_LATENCY_HISTOGRAM_BUCKET_COUNT];
+    uint64_t total = 0;
+
+    for (size_t i = 0; i < ASSENT_LATENCY_HISTOGRAM_BUCKET_COUNT; ++i) {
+        counts[i] = assentAtomicLoad(&self->buckets[i]);
+        total += counts[i];
+    }
+
+    target->count = total;
+    target->p50Ns = 0;
+    target->p99Ns = 0;
+    target->p999Ns = 0;
+    target->maxNs = 0;
+    if (total == 0) {
+        return;
+    }
+
+    const uint64_t p50Rank = (total * 500 + 999) / 1000;
+    const uint64_t p99Rank = (total * 990 + 999) / 1000;
+    const uint64_t p999Rank = (total * 999 + 999) / 1000;
+    uint64_t accumulated = 0;
+
+    for (size_t i = 0; i < ASSENT_LATENCY_HISTOGRAM_BUCKET_COUNT; ++i) {
+        if (counts[i] == 0) {
+            continue;
+        }
+        const uint64_t previous = accumulated;
+        accumulated += counts[i];
+        const uint64_t upperBound = bucketUpperBound(i);
+        if (previous < p50Rank && accumulated >= p50Rank) {
+            target->p50Ns = upperBound;
+        }
+        if (previous < p99Rank && accumulated >= p99Rank) {
+            target->p99Ns = upperBound;
+        }
+        if (previous < p999Rank && accumulated >= p999Rank) {
+            target->p999Ns = upperBound;
+        }
+        target->maxNs = upperBound;
+    }
+}
+
+void assentLatencyHistogramReset(AssentLatencyHistogram* self)
+{
+    for (size_t i = 0; i < ASSENT_LATENCY_HISTOGRAM_BUCKET_COUNT; ++i) {
+        assentAtomicStore(&self->buckets[i], 0);
+    }
+}
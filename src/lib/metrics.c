@@ -0,0 +1,43 @@
+/*---------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved.
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------*/
+#include <assent/metrics.h>
+
+void assentMetricsCountersInit(AssentMetricsCounters* self)
+{
+    assentAtomicStore(&self->updateCount, 0);
+    assentAtomicStore(&self->stepsConsumed, 0);
+    assentAtomicStore(&self->octetsParsed, 0);
+    assentAtomicStore(&self->parseNs, 0);
+    assentAtomicStore(&self->preTicksNs, 0);
+    assentAtomicStore(&self->tickNs, 0);
+}
+
+/// There is only one writer, so each counter can be updated with a plain load and an atomic store,
+/// readers never see a torn value.
+static void addToCounter(volatile uint64_t* counter, uint64_t add)
+{
+    assentAtomicStore(counter, assentAtomicLoad(counter) + add);
+}
+
+void assentMetricsCountersAdd(AssentMetricsCounters* self, const AssentUpdateMetrics* metrics)
+{
+    addToCounter(&self->updateCount, 1);
+    addToCounter(&self->stepsConsumed, metrics->stepsConsumed);
+    addToCounter(&self->octetsParsed, metrics->octetsParsed);
+    addToCounter(&self->parseNs, metrics->parseNs);
+    addToCounter(&self->preTicksNs, metrics->preTicksNs);
+    addToCounter(&self->tickNs, metrics->tickNs);
+}
+
+/// Each counter is read atomically, but the counters are not read as one consistent set.
+void assentMetricsCountersRead(const AssentMetricsCounters* self, AssentMetricsTotals* target)
+{
+    target->updateCount = assentAtomicLoad(&self->updateCount);
+    target->stepsConsumed = assentAtomicLoad(&self->stepsConsumed);
+    target->octetsParsed = assentAtomicLoad(&self->octetsParsed);
+    target->parseNs = assentAtomicLoad(&self->parseNs);
+    target->preTicksNs = assentAtomicLoad(&self->preTicksNs);
+    target->tickNs = assentAtomicLoad(&self->tickNs);
+}
@@ -0,0 +1,63 @@
+/*---------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved.
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------*/
+#include <assent/ready_queue.h>
+#include <imprint/allocator.h>
+
+/// A cell is free for enqueue number n when its sequence is n, and holds an item for dequeue number n when its
+/// sequence is n + 1.
+void assentReadyQueueInit(AssentReadyQueue* self, struct ImprintAllocator* allocator, size_t capacity)
+{
+    self->capacity = capacity;
+    self->cells = IMPRINT_CALLOC_TYPE_COUNT(allocator, AssentReadyQueueCell, capacity);
+    for (size_t i = 0; i < capacity; ++i) {
+        self->cells[i].sequence = i;
+    }
+    self->enqueueCount = 0;
+    self->dequeueCount = 0;
+}
+
+/// Any thread. @return false if the queue is full
+bool assentReadyQueueEnqueue(AssentReadyQueue* self, uint64_t item)
+{
+    uint64_t position = assentAtomicLoad(&self->enqueueCount);
+
+    for (;;) {
+        AssentReadyQueueCell* cell = &self->cells[position % self->capacity];
+        const uint64_t sequence = assentAtomicLoad(&cell->sequence);
+        if (sequence == position) {
+            if (assentAtomicCompareExchange(&self->enqueueCount, &position, position + 1)) {
+                assentAtomicStore(&cell->item, item);
+                assentAtomicStore(&cell->sequence, position + 1);
+                return true;
+            }
+        } else if (sequence < position) {
+            return false;
+        } else {
+            position = assentAtomicLoad(&self->enqueueCount);
+        }
+    }
+}
+
+/// Any thread. @return false if the queue is empty
+bool assentReadyQueueDequeue(AssentReadyQueue* self, uint64_t* outItem)
+{
+    uint64_t position = assentAtomicLoad(&self->dequeueCount);
+
+    for (;;) {
+        AssentReadyQueueCell* cell = &self->cells[position % self->capacity];
+        const uint64_t sequence = assentAtomicLoad(&cell->sequence);
+        if (sequence == position + 1) {
+            if (assentAtomicCompareExchange(&self->dequeueCount, &position, position + 1)) {
+                *outItem = assentAtomicLoad(&cell->item);
+                assentAtomicStore(&cell->sequence, position + self->capacity);
+                return true;
+            }
+        } else if (sequence < position + 1) {
+            return false;
+        } else {
+            position = assentAtomicLoad(&self->dequeueCount);
+        }
+    }
+}
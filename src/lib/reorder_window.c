@@ -0,0 +1,137 @@
+/*---------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved.
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------*/
+#include <assent/reorder_window.h>
+#include <imprint/allocator.h>
+#include <tiny-libc/tiny_libc.h>
+
+static bool isPresent(const AssentReorderWindow* self, StepId stepId)
+{
+    const size_t index = stepId % self->capacity;
+    return (self->presentBits[index / 64] >> (index % 64)) & 1U;
+}
+
+static void setPresent(AssentReorderWindow* self, StepId stepId, bool present)
+{
+    const size_t index = stepId % self->capacity;
+    const uint64_t mask = (uint64_t) 1U << (index % 64);
+    if (present) {
+        self->presentBits[index / 64] |= mask;
+    } else {
+        self->presentBits[index / 64] &= ~mask;
+    }
+}
+
+/// The capacity is rounded up to a multiple of 64, so the bitmap has no partial words.
+void assentReorderWindowInit(AssentReorderWindow* self, struct ImprintAllocator* allocator, size_t capacity,
+                             size_t maxOctetCount, StepId firstStepId)
+{
+    const size_t wordCount = (capacity + 63) / 64;
+    self->capacity = wordCount * 64;
+    self->maxOctetCount = maxOctetCount;
+    self->presentBits = IMPRINT_CALLOC_TYPE_COUNT(allocator, uint64_t, wordCount);
+    self->octets = IMPRINT_ALLOC_TYPE_COUNT(allocator, uint8_t, self->capacity * maxOctetCount);
+    self->octetCounts = IMPRINT_CALLOC_TYPE_COUNT(allocator, size_t, self->capacity);
+    self->nextStepId = firstStepId;
+    self->highestStepId = firstStepId;
+    self->count = 0;
+}
+
+/// Stores a step that can not be added in order yet.
+/// @return 0 if stored, ASSENT_REORDER_WINDOW_STALE if it is before the window or already stored,
+/// ASSENT_REORDER_WINDOW_TOO_FAR_AHEAD if it is after the window, ASSENT_REORDER_WINDOW_TOO_LARGE if it does not fit.
+int assentReorderWindowInsert(AssentReorderWindow* self, StepId stepId, const uint8_t* octets, size_t octetCount)
+{
+    if (stepId < self->nextStepId) {
+        return ASSENT_REORDER_WINDOW_STALE;
+    }
+    if (stepId - self->nextStepId >= self->capacity) {
+        return ASSENT_REORDER_WINDOW_TOO_FAR_AHEAD;
+    }
+    if (octetCount > self->maxOctetCount) {
+        return ASSENT_REORDER_WINDOW_TOO_LARGE;
+    }
+    if (isPresent(self, stepId)) {
+        return ASSENT_REORDER_WINDOW_STALE;
+    }
+
+    const size_t index = stepId % self->capacity;
+    tc_memcpy_octets(&self->octets[index * self->maxOctetCount], octets, octetCount);
+    self->octetCounts[index] = octetCount;
+    setPresent(self, stepId, true);
+    if (self->count == 0 || stepId > self->highestStepId) {
+        self->highestStepId = stepId;
+    }
+    self->count++;
+
+    return 0;
+}
+
+/// Checks if the step has been stored in the window.
+bool assentReorderWindowContains(const AssentReorderWindow* self, StepId stepId)
+{
+    if (stepId < self->nextStepId || stepId - self->nextStepId >= self->capacity) {
+        return false;
+    }
+
+    return isPresent(self, stepId);
+}
+
+/// Gets the step for nextStepId, if it has been received.
+bool assentReorderWindowPeek(const AssentReorderWindow* self, const uint8_t** outOctets, size_t* outOctetCount)
+{
+    if (self->count == 0 || !isPresent(self, self->nextStepId)) {
+        return false;
+    }
+
+    const size_t index = self->nextStepId % self->capacity;
+    *outOctets = &self->octets[index * self->maxOctetCount];
+    *outOctetCount = self->octetCounts[index];
+
+    return true;
+}
+
+/// Moves the start of the window forward to stepId, dropping any steps stored before it.
+/// Moving it backwards drops all the stored steps.
+void assentReorderWindowSkipTo(AssentReorderWindow* self, StepId stepId)
+{
+    if (stepId == self->nextStepId) {
+        return;
+    }
+    if (stepId < self->nextStepId || stepId - self->nextStepId >= self->capacity) {
+        tc_mem_clear_type_n(self->presentBits, self->capacity / 64);
+        self->count = 0;
+        self->nextStepId = stepId;
+        return;
+    }
+    for (; self->nextStepId < stepId && self->count > 0; ++self->nextStepId) {
+        if (isPresent(self, self->nextStepId)) {
+            setPresent(self, self->nextStepId, false);
+            self->count--;
+        }
+    }
+    if (self->nextStepId < stepId) {
+        self->nextStepId = stepId;
+    }
+}
+
+/// Lists the StepIds that have not been received, from nextStepId up to the highest StepId stored, so they can be
+/// requested again before they are needed.
+/// @return the number of StepIds written to outStepIds.
+size_t assentReorderWindowMissing(const AssentReorderWindow* self, StepId* outStepIds, size_t maxCount)
+{
+    size_t missingCount = 0;
+
+    if (self->count == 0) {
+        return 0;
+    }
+
+    for (StepId stepId = self->nextStepId; stepId < self->highestStepId && missingCount < maxCount; ++stepId) {
+        if (!isPresent(self, stepId)) {
+            outStepIds[missingCount++] = stepId;
+        }
+    }
+
+    return missingCount;
+}
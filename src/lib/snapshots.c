@@ -0,0 +1,272 @@
+/*---------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved.
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------*/
+#include <assent/snapshots.h>
+#include <clog/clog.h>
+#include <imprint/allocator.h>
+#include <tiny-libc/tiny_libc.h>
+
+#define ASSENT_SNAPSHOT_BLOCK_HEADER_OCTET_COUNT (4)
+
+/// Preallocates `capacity` snapshot slabs of `maxOctetCount` octets each, so taking a snapshot never allocates.
+void assentSnapshotsInit(AssentSnapshots* self, struct ImprintAllocator* allocator, size_t capacity,
+                         size_t maxOctetCount)
+{
+    self->capacity = capacity;
+    self->maxOctetCount = maxOctetCount;
+    self->snapshots = 0;
+    self->blockSize = 0;
+    self->blockCount = 0;
+    self->keyframeInterval = 0;
+    self->dirtyBlocks = 0;
+    self->restoreBuffer = 0;
+
+    if (capacity != 0) {
+        self->snapshots = IMPRINT_ALLOC_TYPE_COUNT(allocator, AssentSnapshot, capacity);
+        uint8_t* slabs = IMPRINT_ALLOC_TYPE_COUNT(allocator, uint8_t, capacity * maxOctetCount);
+        for (size_t i = 0; i < capacity; ++i) {
+            self->snapshots[i].octets = &slabs[i * maxOctetCount];
+            self->snapshots[i].octetCount = 0;
+            self->snapshots[i].stateOctetCount = 0;
+            self->snapshots[i].isKeyframe = true;
+            self->snapshots[i].stepId = NIMBLE_STEP_MAX;
+        }
+    }
+
+    assentSnapshotsClear(self);
+}
+
+/// Switches to incremental snapshots. The serialized state is split into blocks of `blockSize` octets and only the
+/// blocks that changed since the previous snapshot are stored, with a full keyframe every `keyframeInterval`
+/// snapshots. Changed blocks are either found by comparing with the previous serialized state, or reported by the
+/// application with assentSnapshotsMarkDirty().
+void assentSnapshotsInitIncremental(AssentSnapshots* self, struct ImprintAllocator* allocator, size_t blockSize,
+                                    size_t keyframeInterval, AssentSnapshotDirtyTracking dirtyTracking)
+{
+    CLOG_ASSERT(blockSize > 0, "snapshot block size must be set")
+    CLOG_ASSERT(keyframeInterval > 0 && keyframeInterval < self->capacity,
+                "snapshot keyframe interval must be less than the snapshot count, or nothing can be restored")
+
+    self->blockSize = blockSize;
+    self->blockCount = (self->maxOctetCount + blockSize - 1) / blockSize;
+    self->keyframeInterval = keyframeInterval;
+    self->dirtyTracking = dirtyTracking;
+    self->dirtyBlocks = IMPRINT_CALLOC_TYPE_COUNT(allocator, uint64_t, (self->blockCount + 63) / 64);
+    self->stateBuffers[0] = IMPRINT_ALLOC_TYPE_COUNT(allocator, uint8_t, self->maxOctetCount);
+    self->stateBuffers[1] = IMPRINT_ALLOC_TYPE_COUNT(allocator, uint8_t, self->maxOctetCount);
+    self->restoreBuffer = IMPRINT_ALLOC_TYPE_COUNT(allocator, uint8_t, self->maxOctetCount);
+
+    assentSnapshotsClear(self);
+}
+
+void assentSnapshotsClear(AssentSnapshots* self)
+{
+    self->headIndex = 0;
+    self->count = 0;
+    self->snapshotsSinceKeyframe = 0;
+    self->canWriteDelta = false;
+    self->currentStateBufferIndex = 0;
+    self->previousStateOctetCount = 0;
+}
+
+/// Returns the slab to serialize the next full snapshot into, which is the oldest snapshot if the ring is full.
+/// The snapshot is not visible until assentSnapshotsCommit() is called.
+AssentSnapshot* assentSnapshotsBeginWrite(AssentSnapshots* self)
+{
+    if (self->capacity == 0) {
+        return 0;
+    }
+
+    if (self->count == self->capacity) {
+        self->count--;
+    }
+
+    return &self->snapshots[self->headIndex];
+}
+
+void assentSnapshotsCommit(AssentSnapshots* self, StepId stepId, size_t octetCount)
+{
+    AssentSnapshot* snapshot = &self->snapshots[self->headIndex];
+    snapshot->stepId = stepId;
+    snapshot->octetCount = octetCount;
+    snapshot->stateOctetCount = octetCount;
+    snapshot->isKeyframe = true;
+
+    self->headIndex = (self->headIndex + 1) % self->capacity;
+    self->count++;
+}
+
+/// The buffer to serialize the complete state into before calling assentSnapshotsCommitIncremental().
+uint8_t* assentSnapshotsIncrementalTarget(AssentSnapshots* self)
+{
+    return self->stateBuffers[self->currentStateBufferIndex];
+}
+
+void assentSnapshotsMarkDirty(AssentSnapshots* self, size_t octetOffset, size_t octetCount)
+{
+    if (self->blockSize == 0 || octetCount == 0) {
+        return;
+    }
+
+    const size_t lastBlockIndex = (octetOffset + octetCount - 1) / self->blockSize;
+    for (size_t blockIndex = octetOffset / self->blockSize; blockIndex <= lastBlockIndex; ++blockIndex) {
+        if (blockIndex >= self->blockCount) {
+            break;
+        }
+        self->dirtyBlocks[blockIndex / 64] |= 1ULL << (blockIndex % 64);
+    }
+}
+
+static bool isBlockChanged(const AssentSnapshots* self, size_t blockIndex, const uint8_t* current,
+                           size_t blockOctetCount)
+{
+    if (self->dirtyTracking == AssentSnapshotDirtyTrackingReportedBlocks) {
+        return (self->dirtyBlocks[blockIndex / 64] & (1ULL << (blockIndex % 64))) != 0;
+    }
+
+    const uint8_t* previous = self->stateBuffers[self->currentStateBufferIndex ^ 1];
+    const size_t offset = blockIndex * self->blockSize;
+
+    return tc_memcmp(current + offset, previous + offset, blockOctetCount) != 0;
+}
+
+/// Writes the changed blocks as [blockIndex (4 octets)][block octets] records.
+/// @return the delta octet count, or -1 if the delta would not fit in the snapshot slab.
+static int writeDelta(const AssentSnapshots* self, const uint8_t* current, size_t stateOctetCount, uint8_t* target)
+{
+    size_t pos = 0;
+    const size_t usedBlockCount = (stateOctetCount + self->blockSize - 1) / self->blockSize;
+
+    for (size_t blockIndex = 0; blockIndex < usedBlockCount; ++blockIndex) {
+        const size_t offset = blockIndex * self->blockSize;
+        const size_t blockOctetCount = stateOctetCount - offset < self->blockSize ? stateOctetCount - offset
+                                                                                  : self->blockSize;
+        if (!isBlockChanged(self, blockIndex, current, blockOctetCount)) {
+            continue;
+        }
+
+        if (pos + ASSENT_SNAPSHOT_BLOCK_HEADER_OCTET_COUNT + blockOctetCount > self->maxOctetCount) {
+            return -1;
+        }
+
+        target[pos++] = (uint8_t) (blockIndex >> 24);
+        target[pos++] = (uint8_t) (blockIndex >> 16);
+        target[pos++] = (uint8_t) (blockIndex >> 8);
+        target[pos++] = (uint8_t) blockIndex;
+        tc_memcpy_octets(target + pos, current + offset, blockOctetCount);
+        pos += blockOctetCount;
+    }
+
+    return (int) pos;
+}
+
+/// Stores the state that was serialized into assentSnapshotsIncrementalTarget(), either as a keyframe or as
+/// the blocks that changed since the previous snapshot.
+void assentSnapshotsCommitIncremental(AssentSnapshots* self, StepId stepId, size_t stateOctetCount)
+{
+    const uint8_t* current = self->stateBuffers[self->currentStateBufferIndex];
+    AssentSnapshot* snapshot = assentSnapshotsBeginWrite(self);
+
+    bool isKeyframe = !self->canWriteDelta || self->snapshotsSinceKeyframe + 1 >= self->keyframeInterval ||
+                      stateOctetCount != self->previousStateOctetCount;
+    if (!isKeyframe) {
+        const int deltaOctetCount = writeDelta(self, current, stateOctetCount, snapshot->octets);
+        if (deltaOctetCount < 0) {
+            isKeyframe = true;
+        } else {
+            snapshot->octetCount = (size_t) deltaOctetCount;
+        }
+    }
+
+    if (isKeyframe) {
+        tc_memcpy_octets(snapshot->octets, current, stateOctetCount);
+        snapshot->octetCount = stateOctetCount;
+        self->snapshotsSinceKeyframe = 0;
+    } else {
+        self->snapshotsSinceKeyframe++;
+    }
+
+    snapshot->stepId = stepId;
+    snapshot->stateOctetCount = stateOctetCount;
+    snapshot->isKeyframe = isKeyframe;
+
+    self->headIndex = (self->headIndex + 1) % self->capacity;
+    self->count++;
+
+    self->canWriteDelta = true;
+    self->previousStateOctetCount = stateOctetCount;
+    self->currentStateBufferIndex ^= 1;
+    tc_mem_clear_type_n(self->dirtyBlocks, (self->blockCount + 63) / 64);
+}
+
+/// Finds the latest snapshot taken at or before the StepId.
+const AssentSnapshot* assentSnapshotsFindAtOrBefore(const AssentSnapshots* self, StepId stepId)
+{
+    for (size_t i = 0; i < self->count; ++i) {
+        const size_t index = (self->headIndex + self->capacity - 1 - i) % self->capacity;
+        const AssentSnapshot* snapshot = &self->snapshots[index];
+        if (snapshot->stepId <= stepId) {
+            return snapshot;
+        }
+    }
+
+    return 0;
+}
+
+static void applyDelta(const AssentSnapshots* self, const AssentSnapshot* delta, uint8_t* target)
+{
+    size_t pos = 0;
+    while (pos < delta->octetCount) {
+        const uint8_t* header = &delta->octets[pos];
+        const size_t blockIndex = ((size_t) header[0] << 24) | ((size_t) header[1] << 16) |
+                                  ((size_t) header[2] << 8) | header[3];
+        pos += ASSENT_SNAPSHOT_BLOCK_HEADER_OCTET_COUNT;
+
+        const size_t offset = blockIndex * self->blockSize;
+        const size_t blockOctetCount = delta->stateOctetCount - offset < self->blockSize
+                                           ? delta->stateOctetCount - offset
+                                           : self->blockSize;
+        tc_memcpy_octets(target + offset, &delta->octets[pos], blockOctetCount);
+        pos += blockOctetCount;
+    }
+}
+
+/// Gets the complete serialized state of a snapshot. Keyframes are handed out as is, incremental snapshots are
+/// rebuilt from the preceding keyframe into a restore buffer that is overwritten by the next restore.
+/// @return 0 on success, -1 if the keyframe the snapshot depends on has already been overwritten.
+int assentSnapshotsRestore(AssentSnapshots* self, const AssentSnapshot* snapshot, const uint8_t** outOctets,
+                           size_t* outOctetCount)
+{
+    *outOctetCount = snapshot->stateOctetCount;
+
+    if (snapshot->isKeyframe) {
+        *outOctets = snapshot->octets;
+        return 0;
+    }
+
+    const size_t oldestIndex = (self->headIndex + self->capacity - self->count) % self->capacity;
+    const size_t targetIndex = (size_t) (snapshot - self->snapshots);
+
+    size_t keyframeIndex = targetIndex;
+    while (!self->snapshots[keyframeIndex].isKeyframe) {
+        if (keyframeIndex == oldestIndex) {
+            return -1;
+        }
+        keyframeIndex = (keyframeIndex + self->capacity - 1) % self->capacity;
+    }
+
+    const AssentSnapshot* keyframe = &self->snapshots[keyframeIndex];
+    tc_memcpy_octets(self->restoreBuffer, keyframe->octets, keyframe->octetCount);
+
+    for (size_t index = (keyframeIndex + 1) % self->capacity;; index = (index + 1) % self->capacity) {
+        applyDelta(self, &self->snapshots[index], self->restoreBuffer);
+        if (index == targetIndex) {
+            break;
+        }
+    }
+
+    *outOctets = self->restoreBuffer;
+
+    return 0;
+}
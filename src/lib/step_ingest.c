@@ -0,0 +1,202 @@
+/*---------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved.
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------*/
+#include <assent/step_ingest.h>
+#include <imprint/allocator.h>
+#include <tiny-libc/tiny_libc.h>
+
+#define ASSENT_STEP_INGEST_PHASE_FREE (0U)
+#define ASSENT_STEP_INGEST_PHASE_WRITING (1U)
+#define ASSENT_STEP_INGEST_PHASE_READY (2U)
+#define ASSENT_STEP_INGEST_PHASE_MASK (3U)
+
+static uint64_t slotState(StepId stepId, uint64_t phase)
+{
+    return ((uint64_t) stepId << 2) | phase;
+}
+
+static StepId slotStepId(uint64_t state)
+{
+    return (StepId) (state >> 2);
+}
+
+/// The first StepId at or after `stepId` that maps to slot `index`.
+static StepId stepIdForSlot(const AssentStepIngest* self, size_t index, StepId stepId)
+{
+    const size_t firstIndex = stepId % self->capacity;
+    return (StepId) (stepId + (index + self->capacity - firstIndex) % self->capacity);
+}
+
+void assentStepIngestInit(AssentStepIngest* self, struct ImprintAllocator* allocator, size_t capacity,
+                          size_t maxOctetCount, StepId firstStepId)
+{
+    self->capacity = capacity;
+    self->maxOctetCount = maxOctetCount;
+    self->slots = IMPRINT_ALLOC_TYPE_COUNT(allocator, AssentStepIngestSlot, capacity);
+    uint8_t* slabs = IMPRINT_ALLOC_TYPE_COUNT(allocator, uint8_t, capacity * maxOctetCount);
+    for (size_t i = 0; i < capacity; ++i) {
+        self->slots[i].octets = &slabs[i * maxOctetCount];
+        self->slots[i].octetCount = 0;
+        self->slots[i].state = slotState(stepIdForSlot(self, i, firstStepId), ASSENT_STEP_INGEST_PHASE_FREE);
+    }
+    self->nextReadStepId = firstStepId;
+    self->duplicateCount = 0;
+}
+
+/// Producer side, can be called from any thread. Claims the slot for the StepId.
+/// @return 0 with `outOctets` set to the slot to write the step into, ASSENT_STEP_INGEST_DUPLICATE if the step has
+/// already been added or consumed, ASSENT_STEP_INGEST_TOO_FAR_AHEAD if the consumer has not caught up enough yet.
+int assentStepIngestReserve(AssentStepIngest* self, StepId stepId, uint8_t** outOctets)
+{
+    AssentStepIngestSlot* slot = &self->slots[stepId % self->capacity];
+    uint64_t state = assentAtomicLoad(&slot->state);
+
+    for (;;) {
+        const StepId forStepId = slotStepId(state);
+        if (stepId < forStepId || (stepId == forStepId && (state & ASSENT_STEP_INGEST_PHASE_MASK) !=
+                                                              ASSENT_STEP_INGEST_PHASE_FREE)) {
+            assentAtomicFetchAdd(&self->duplicateCount, 1);
+            return ASSENT_STEP_INGEST_DUPLICATE;
+        }
+        if (stepId > forStepId) {
+            return ASSENT_STEP_INGEST_TOO_FAR_AHEAD;
+        }
+        if (assentAtomicCompareExchange(&slot->state, &state,
+                                        slotState(stepId, ASSENT_STEP_INGEST_PHASE_WRITING))) {
+            break;
+        }
+    }
+
+    *outOctets = slot->octets;
+
+    return 0;
+}
+
+/// Producer side. Publishes the step written into the slot claimed with assentStepIngestReserve().
+void assentStepIngestCommit(AssentStepIngest* self, StepId stepId, size_t octetCount, uint64_t arrivalTimeNs)
+{
+    AssentStepIngestSlot* slot = &self->slots[stepId % self->capacity];
+    slot->octetCount = octetCount;
+    slot->arrivalTimeNs = arrivalTimeNs;
+    assentAtomicStore(&slot->state, slotState(stepId, ASSENT_STEP_INGEST_PHASE_READY));
+}
+
+/// Producer side. Gives up the slot claimed with assentStepIngestReserve(), e.g. when the step turned out to be
+/// malformed, so the step can be added again.
+void assentStepIngestCancel(AssentStepIngest* self, StepId stepId)
+{
+    AssentStepIngestSlot* slot = &self->slots[stepId % self->capacity];
+    assentAtomicStore(&slot->state, slotState(stepId, ASSENT_STEP_INGEST_PHASE_FREE));
+}
+
+/// Producer side, can be called from any thread. Tells if the slot of the StepId is still used by an earlier step,
+/// so that assentStepIngestReserve() would return ASSENT_STEP_INGEST_TOO_FAR_AHEAD.
+bool assentStepIngestIsTooFarAhead(const AssentStepIngest* self, StepId stepId)
+{
+    const AssentStepIngestSlot* slot = &self->slots[stepId % self->capacity];
+
+    return stepId > slotStepId(assentAtomicLoad(&slot->state));
+}
+
+/// Producer side, can be called from any thread.
+/// @return 0 if added, ASSENT_STEP_INGEST_DUPLICATE if dropped as a duplicate, negative on error.
+int assentStepIngestPush(AssentStepIngest* self, StepId stepId, const uint8_t* octets, size_t octetCount,
+                         uint64_t arrivalTimeNs)
+{
+    if (octetCount > self->maxOctetCount) {
+        return ASSENT_STEP_INGEST_TOO_LARGE;
+    }
+
+    uint8_t* target;
+    const int result = assentStepIngestReserve(self, stepId, &target);
+    if (result != 0) {
+        return result;
+    }
+
+    tc_memcpy_octets(target, octets, octetCount);
+    assentStepIngestCommit(self, stepId, octetCount, arrivalTimeNs);
+
+    return 0;
+}
+
+/// Consumer side. Returns the slot for the next StepId in order, or NULL if that step has not been added yet.
+const AssentStepIngestSlot* assentStepIngestPeek(const AssentStepIngest* self)
+{
+    return assentStepIngestPeekAt(self, 0);
+}
+
+/// Consumer side. Returns the slot for the StepId `offset` steps after the next one, or NULL if that step has not
+/// been added yet.
+const AssentStepIngestSlot* assentStepIngestPeekAt(const AssentStepIngest* self, size_t offset)
+{
+    const StepId stepId = (StepId) (self->nextReadStepId + offset);
+    const AssentStepIngestSlot* slot = &self->slots[stepId % self->capacity];
+    if (assentAtomicLoad(&slot->state) != slotState(stepId, ASSENT_STEP_INGEST_PHASE_READY)) {
+        return 0;
+    }
+
+    return slot;
+}
+
+/// Consumer side. Frees the slot of the next StepId for the step `capacity` steps later.
+void assentStepIngestPop(AssentStepIngest* self)
+{
+    AssentStepIngestSlot* slot = &self->slots[self->nextReadStepId % self->capacity];
+    assentAtomicStore(&slot->state,
+                      slotState((StepId) (self->nextReadStepId + self->capacity), ASSENT_STEP_INGEST_PHASE_FREE));
+    self->nextReadStepId++;
+}
+
+/// Consumer side. Counts the steps that have been added from the next StepId and on, up to the first missing one.
+size_t assentStepIngestReadyCount(const AssentStepIngest* self)
+{
+    size_t count = 0;
+    while (count < self->capacity && assentStepIngestPeekAt(self, count) != 0) {
+        count++;
+    }
+
+    return count;
+}
+
+/// Frees the slot for targetStepId, unless it already is for that step or a later one.
+static void freeSlotFor(AssentStepIngestSlot* slot, StepId targetStepId)
+{
+    uint64_t state = assentAtomicLoad(&slot->state);
+
+    for (;;) {
+        if (slotStepId(state) >= targetStepId) {
+            return;
+        }
+        if ((state & ASSENT_STEP_INGEST_PHASE_MASK) == ASSENT_STEP_INGEST_PHASE_WRITING) {
+            // a producer is writing an obsolete step, wait for it to commit
+            state = assentAtomicLoad(&slot->state);
+            continue;
+        }
+        if (assentAtomicCompareExchange(&slot->state, &state, slotState(targetStepId, ASSENT_STEP_INGEST_PHASE_FREE))) {
+            return;
+        }
+    }
+}
+
+/// Consumer side. Like assentStepIngestPop(), but the next step does not have to have been added. A producer that
+/// is writing it is waited for.
+void assentStepIngestDrop(AssentStepIngest* self)
+{
+    freeSlotFor(&self->slots[self->nextReadStepId % self->capacity], (StepId) (self->nextReadStepId + self->capacity));
+    self->nextReadStepId++;
+}
+
+/// Consumer side. Drops everything before the StepId, e.g. after a snapshot has been applied.
+void assentStepIngestSkipTo(AssentStepIngest* self, StepId stepId)
+{
+    if (stepId <= self->nextReadStepId) {
+        return;
+    }
+
+    for (size_t i = 0; i < self->capacity; ++i) {
+        freeSlotFor(&self->slots[i], stepIdForSlot(self, i, stepId));
+    }
+
+    self->nextReadStepId = stepId;
+}
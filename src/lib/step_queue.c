@@ -0,0 +1,95 @@
+/*---------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved.
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------*/
+#include <assent/step_queue.h>
+#include <imprint/allocator.h>
+#include <tiny-libc/tiny_libc.h>
+
+void assentStepQueueInit(AssentStepQueue* self, struct ImprintAllocator* allocator, size_t capacity,
+                         size_t maxOctetCount)
+{
+    self->capacity = capacity;
+    self->maxOctetCount = maxOctetCount;
+    self->slots = IMPRINT_ALLOC_TYPE_COUNT(allocator, AssentStepQueueSlot, capacity);
+    uint8_t* slabs = IMPRINT_ALLOC_TYPE_COUNT(allocator, uint8_t, capacity * maxOctetCount);
+    for (size_t i = 0; i < capacity; ++i) {
+        self->slots[i].octets = &slabs[i * maxOctetCount];
+        self->slots[i].octetCount = 0;
+        self->slots[i].stepId = NIMBLE_STEP_MAX;
+    }
+    self->nextStepId = 0;
+    self->writeCount = 0;
+    self->readCount = 0;
+}
+
+/// Producer side. Returns the slot octets to write the next step into, or NULL if the queue is full.
+/// The step is not visible to the consumer until assentStepQueueCommit() is called.
+uint8_t* assentStepQueueReserve(AssentStepQueue* self)
+{
+    const uint64_t writeCount = self->writeCount;
+    if (writeCount - assentAtomicLoad(&self->readCount) >= self->capacity) {
+        return 0;
+    }
+
+    return self->slots[writeCount % self->capacity].octets;
+}
+
+/// Producer side. Publishes the step written into the reserved slot.
+void assentStepQueueCommit(AssentStepQueue* self, StepId stepId, size_t octetCount, uint64_t arrivalTimeNs)
+{
+    const uint64_t writeCount = self->writeCount;
+    AssentStepQueueSlot* slot = &self->slots[writeCount % self->capacity];
+    slot->stepId = stepId;
+    slot->octetCount = octetCount;
+    slot->arrivalTimeNs = arrivalTimeNs;
+    if (stepId >= self->nextStepId) {
+        self->nextStepId = (StepId) (stepId + 1);
+    }
+
+    assentAtomicStore(&self->writeCount, writeCount + 1);
+}
+
+/// Producer side. @return 0 on success, -1 if the queue is full, -2 if the step is too large.
+int assentStepQueuePush(AssentStepQueue* self, StepId stepId, const uint8_t* octets, size_t octetCount,
+                        uint64_t arrivalTimeNs)
+{
+    if (octetCount > self->maxOctetCount) {
+        return -2;
+    }
+
+    uint8_t* target = assentStepQueueReserve(self);
+    if (target == 0) {
+        return -1;
+    }
+
+    tc_memcpy_octets(target, octets, octetCount);
+    assentStepQueueCommit(self, stepId, octetCount, arrivalTimeNs);
+
+    return 0;
+}
+
+/// Consumer side. Returns the oldest step, or NULL if the queue is empty. The slot stays valid until
+/// assentStepQueuePop() is called.
+const AssentStepQueueSlot* assentStepQueuePeek(const AssentStepQueue* self)
+{
+    const uint64_t readCount = self->readCount;
+    if (readCount == assentAtomicLoad(&self->writeCount)) {
+        return 0;
+    }
+
+    return &self->slots[readCount % self->capacity];
+}
+
+/// Consumer side. Hands the oldest slot back to the producer.
+void assentStepQueuePop(AssentStepQueue* self)
+{
+    assentAtomicStore(&self->readCount, self->readCount + 1);
+}
+
+/// Approximate number of steps in the queue, can be called from any thread.
+size_t assentStepQueueCount(const AssentStepQueue* self)
+{
+    const uint64_t readCount = assentAtomicLoad(&self->readCount);
+    return (size_t) (assentAtomicLoad(&self->writeCount) - readCount);
+}
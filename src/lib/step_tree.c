@@ -0,0 +1,108 @@
+/*---------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved.
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------*/
+#include <assent/hash_mix.h>
+#include <assent/step_tree.h>
+#include <clog/clog.h>
+#include <imprint/allocator.h>
+
+/// Initializes a step tree over the latest `leafCount` steps. `leafCount` must be a power of two, 0 disables it.
+/// Node ranges are aligned on the StepId (a level `n` node always starts on a multiple of 2^n), so two peers
+/// get the same digest for the same range regardless of when they started to fill the tree.
+void assentStepTreeInit(AssentStepTree* self, struct ImprintAllocator* allocator, size_t leafCount)
+{
+    CLOG_ASSERT((leafCount & (leafCount - 1)) == 0, "step tree leaf count must be a power of two %zu", leafCount)
+
+    self->leafCount = leafCount;
+    self->levelCount = 0;
+    self->nodes = 0;
+
+    if (leafCount == 0) {
+        return;
+    }
+
+    size_t nodeCount = 0;
+    for (size_t levelWidth = leafCount; levelWidth > 0; levelWidth >>= 1) {
+        CLOG_ASSERT(self->levelCount < ASSENT_STEP_TREE_MAX_LEVELS, "step tree leaf count is too large %zu",
+                    leafCount)
+        self->levelOffsets[self->levelCount++] = nodeCount;
+        nodeCount += levelWidth;
+    }
+
+    self->nodes = IMPRINT_ALLOC_TYPE_COUNT(allocator, AssentStepTreeNode, nodeCount);
+    assentStepTreeClear(self);
+}
+
+void assentStepTreeClear(AssentStepTree* self)
+{
+    if (self->leafCount == 0) {
+        return;
+    }
+
+    const size_t nodeCount = self->levelOffsets[self->levelCount - 1] + 1;
+    for (size_t i = 0; i < nodeCount; ++i) {
+        self->nodes[i].isComplete = false;
+        self->nodes[i].firstStepId = NIMBLE_STEP_MAX;
+        self->nodes[i].hash = 0;
+    }
+}
+
+static AssentStepTreeNode* nodeForStep(AssentStepTree* self, size_t level, StepId stepId)
+{
+    const size_t levelWidth = self->leafCount >> level;
+    return &self->nodes[self->levelOffsets[level] + (stepId >> level) % levelWidth];
+}
+
+/// Adds the hash of a consumed step. Steps must be added in order. Every time a step completes an aligned range,
+/// the digest of that range is updated, so the cost is O(1) amortized and O(log leafCount) at most.
+void assentStepTreeAdd(AssentStepTree* self, StepId stepId, uint64_t stepHash)
+{
+    if (self->leafCount == 0) {
+        return;
+    }
+
+    AssentStepTreeNode* leaf = nodeForStep(self, 0, stepId);
+    leaf->firstStepId = stepId;
+    leaf->hash = stepHash;
+    leaf->isComplete = true;
+
+    for (size_t level = 1; level < self->levelCount; ++level) {
+        const StepId span = (StepId) 1 << level;
+        if ((StepId) (stepId + 1) % span != 0) {
+            break;
+        }
+
+        const StepId firstStepId = (StepId) (stepId + 1 - span);
+        const StepId halfSpan = span >> 1;
+        const AssentStepTreeNode* left = nodeForStep(self, level - 1, firstStepId);
+        const AssentStepTreeNode* right = nodeForStep(self, level - 1, firstStepId + halfSpan);
+        AssentStepTreeNode* parent = nodeForStep(self, level, firstStepId);
+
+        parent->firstStepId = firstStepId;
+        parent->isComplete = left->isComplete && right->isComplete && left->firstStepId == firstStepId &&
+                             right->firstStepId == firstStepId + halfSpan;
+        parent->hash = assentHashMix64(left->hash ^ (right->hash * 0x9e3779b97f4a7c15ULL));
+    }
+}
+
+/// Gets the digest for the 2^level steps starting at firstStepId, which must be a multiple of 2^level.
+/// To find the first divergent step, two peers compare the digest of the widest range first and then
+/// repeatedly continue with the left half if it differs, otherwise the right half, until level 0 is reached.
+/// @return 0 if the digest is available, -1 if the range is not aligned, not complete or no longer in the tree.
+int assentStepTreeDigest(const AssentStepTree* self, size_t level, StepId firstStepId, uint64_t* outDigest)
+{
+    if (level >= self->levelCount || firstStepId % ((StepId) 1 << level) != 0) {
+        return -1;
+    }
+
+    const size_t levelWidth = self->leafCount >> level;
+    const AssentStepTreeNode* node = &self->nodes[self->levelOffsets[level] + (firstStepId >> level) % levelWidth];
+    if (!node->isComplete || node->firstStepId != firstStepId) {
+        return -1;
+    }
+
+    *outDigest = node->hash;
+
+    return 0;
+}
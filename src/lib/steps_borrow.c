@@ -0,0 +1,42 @@
+/*---------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved.
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------*/
+#include <assent/steps_borrow.h>
+
+/// Peeks the combined step `offsetFromRead` steps after the read position without consuming it.
+/// If the step is stored contiguously in the steps buffer, `outOctets` points straight into the storage,
+/// otherwise (the step wraps around the end of the circular buffer) it is copied into `fallback`.
+/// The octets are valid until the step is released with assentStepsRelease().
+/// nimble-steps has no API for this, so it reads the NbsSteps step infos and buffer directly. The
+/// stepsBorrowMatchesRead test compares it with nbsStepsRead() for every step.
+/// @return the octet count of the step, 0 if there is no such step, negative on error.
+int assentStepsBorrow(const NbsSteps* steps, size_t offsetFromRead, StepId* outStepId, const uint8_t** outOctets,
+                      uint8_t* fallback, size_t fallbackOctetCount)
+{
+    if (offsetFromRead >= steps->stepsCount) {
+        *outStepId = NIMBLE_STEP_MAX;
+        *outOctets = 0;
+        return 0;
+    }
+
+    const size_t infoIndex = (steps->infoTailIndex + offsetFromRead) % NBS_WINDOW_SIZE;
+    const NbsStepInfo* info = &steps->infos[infoIndex];
+    *outStepId = info->stepId;
+
+    if (info->positionInBuffer + info->octetCount <= steps->stepsData.capacity) {
+        *outOctets = steps->stepsData.buffer + info->positionInBuffer;
+        return (int) info->octetCount;
+    }
+
+    const int octetCount = nbsStepsReadAtIndex(steps, (int) infoIndex, fallback, fallbackOctetCount);
+    *outOctets = fallback;
+
+    return octetCount;
+}
+
+/// Consumes `stepCount` steps from the read position, invalidating any octets borrowed for them.
+int assentStepsRelease(NbsSteps* steps, size_t stepCount)
+{
+    return nbsStepsDiscardCount(steps, stepCount);
+}
@@ -0,0 +1,63 @@
+/*---------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved.
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------*/
+#include <assent/tick_rate.h>
+
+/// Initializes a controller that aims to keep `targetBacklog` steps buffered.
+/// Any excess is spread evenly over the next `catchUpUpdateCount` updates.
+void assentTickRateControllerInit(AssentTickRateController* self, size_t targetBacklog, size_t catchUpUpdateCount,
+                                  size_t maxTicksPerUpdate)
+{
+    self->targetBacklog = targetBacklog;
+    self->catchUpUpdateCount = catchUpUpdateCount == 0 ? 1 : catchUpUpdateCount;
+    self->maxTicksPerUpdate = maxTicksPerUpdate;
+    self->catchUpStepsLeft = 0;
+    self->catchUpUpdatesLeft = 0;
+    self->lastTickCount = 0;
+}
+
+/// Chooses how many steps to tick this update, given the number of steps currently waiting.
+/// Normally one step is ticked per update. When the backlog is above the target, the excess (except the one step
+/// ticked anyway) is measured once and then paid off in equal parts over the next `catchUpUpdateCount` updates, so
+/// with steps arriving at the tick rate the backlog is back at the target after exactly that many updates. Steps
+/// that arrive in the meantime are caught up on in the next round.
+size_t assentTickRateControllerChoose(AssentTickRateController* self, size_t backlog)
+{
+    if (backlog <= self->targetBacklog) {
+        self->catchUpStepsLeft = 0;
+        self->catchUpUpdatesLeft = 0;
+        self->lastTickCount = 0;
+        return 0;
+    }
+
+    const size_t excess = backlog - self->targetBacklog;
+
+    if (self->catchUpUpdatesLeft == 0) {
+        self->catchUpStepsLeft = excess - 1;
+        self->catchUpUpdatesLeft = self->catchUpStepsLeft == 0 ? 0 : self->catchUpUpdateCount;
+    }
+
+    size_t extraTickCount = 0;
+    if (self->catchUpUpdatesLeft != 0) {
+        // rounded up, so the parts shrink towards the end instead of leaving a remainder for the last update
+        extraTickCount = (self->catchUpStepsLeft + self->catchUpUpdatesLeft - 1) / self->catchUpUpdatesLeft;
+    }
+
+    size_t tickCount = 1 + extraTickCount;
+    if (tickCount > excess) {
+        tickCount = excess;
+    }
+    if (tickCount > self->maxTicksPerUpdate) {
+        tickCount = self->maxTicksPerUpdate;
+    }
+
+    if (self->catchUpUpdatesLeft != 0) {
+        self->catchUpStepsLeft -= tickCount > 1 ? tickCount - 1 : 0;
+        self->catchUpUpdatesLeft--;
+    }
+
+    self->lastTickCount = tickCount;
+
+    return tickCount;
+}
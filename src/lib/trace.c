@@ -0,0 +1,105 @@
+/*---------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved.
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------*/
+#include <assent/trace.h>
+#include <imprint/allocator.h>
+#include <inttypes.h>
+#include <tiny-libc/tiny_libc.h>
+
+void assentTraceInit(AssentTrace* self, struct ImprintAllocator* allocator, size_t capacity)
+{
+    self->capacity = capacity;
+    self->events = IMPRINT_CALLOC_TYPE_COUNT(allocator, AssentTraceEvent, capacity);
+    self->writeCount = 0;
+}
+
+/// Can be called from any thread. The event is claimed with an atomic increment and is not visible to
+/// readers until its sequence has been set.
+void assentTraceAdd(AssentTrace* self, AssentTraceEventType type, uint64_t startNs, uint64_t durationNs,
+                    StepId stepId, uint64_t count)
+{
+    const uint64_t index = assentAtomicFetchAdd(&self->writeCount, 1);
+    AssentTraceEvent* event = &self->events[index % self->capacity];
+
+    assentAtomicStore(&event->sequence, 0);
+    assentAtomicStore(&event->startNs, startNs);
+    assentAtomicStore(&event->durationNs, durationNs);
+    assentAtomicStore(&event->stepIdAndType, ((uint64_t) stepId << 32) | (uint64_t) type);
+    assentAtomicStore(&event->count, count);
+    assentAtomicStore(&event->sequence, index + 1);
+}
+
+static const char* eventName(AssentTraceEventType type)
+{
+    switch (type) {
+        case AssentTraceEventTypeUpdate:
+            return "update";
+        case AssentTraceEventTypeParse:
+            return "parse";
+        case AssentTraceEventTypePreTicks:
+            return "preTicks";
+        case AssentTraceEventTypeTick:
+            return "tick";
+        case AssentTraceEventTypeIngest:
+            return "ingest";
+    }
+
+    return "unknown";
+}
+
+/// Writes the spans in the ring as Chrome trace-event JSON (chrome://tracing, Perfetto). Ingest spans are put on
+/// their own track, since they are usually added from another thread than the update. Spans that are being
+/// written or overwritten while dumping are skipped.
+/// @return the number of octets written (not counting the terminating zero), or -1 if target is too small.
+int assentTraceWriteChromeJson(const AssentTrace* self, char* target, size_t maxTargetOctetSize)
+{
+    const uint64_t writeCount = assentAtomicLoad(&self->writeCount);
+    const uint64_t firstIndex = writeCount > self->capacity ? writeCount - self->capacity : 0;
+    size_t octetCount = 0;
+    const char* separator = "";
+
+    int written = tc_snprintf(target, maxTargetOctetSize, "{\"traceEvents\":[");
+    if (written < 0 || (size_t) written >= maxTargetOctetSize) {
+        return -1;
+    }
+    octetCount += (size_t) written;
+
+    for (uint64_t index = firstIndex; index < writeCount; ++index) {
+        const AssentTraceEvent* event = &self->events[index % self->capacity];
+        const uint64_t sequence = assentAtomicLoad(&event->sequence);
+        if (sequence != index + 1) {
+            continue;
+        }
+        const uint64_t startNs = assentAtomicLoad(&event->startNs);
+        const uint64_t durationNs = assentAtomicLoad(&event->durationNs);
+        const uint64_t stepIdAndType = assentAtomicLoad(&event->stepIdAndType);
+        const uint64_t count = assentAtomicLoad(&event->count);
+        if (assentAtomicLoad(&event->sequence) != sequence) {
+            continue;
+        }
+
+        const AssentTraceEventType type = (AssentTraceEventType) (stepIdAndType & 0xffffffffU);
+        const StepId stepId = (StepId) (stepIdAndType >> 32);
+        written = tc_snprintf(target + octetCount, maxTargetOctetSize - octetCount,
+                              "%s\n{\"name\":\"%s\",\"cat\":\"assent\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,"
+                              "\"ts\":%" PRIu64 ".%03" PRIu64 ",\"dur\":%" PRIu64 ".%03" PRIu64
+                              ",\"args\":{\"stepId\":%" PRIu32 ",\"count\":%" PRIu64 "}}",
+                              separator, eventName(type), type == AssentTraceEventTypeIngest ? 2 : 1,
+                              startNs / 1000, startNs % 1000, durationNs / 1000, durationNs % 1000,
+                              (uint32_t) stepId, count);
+        if (written < 0 || (size_t) written >= maxTargetOctetSize - octetCount) {
+            return -1;
+        }
+        octetCount += (size_t) written;
+        separator = ",";
+    }
+
+    written = tc_snprintf(target + octetCount, maxTargetOctetSize - octetCount, "\n]}\n");
+    if (written < 0 || (size_t) written >= maxTargetOctetSize - octetCount) {
+        return -1;
+    }
+    octetCount += (size_t) written;
+
+    return (int) octetCount;
+}
@@ -0,0 +1,73 @@
+/*---------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved.
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------*/
+#include <assent/work_deque.h>
+#include <imprint/allocator.h>
+
+/// top and bottom start at one, so the owner can step bottom back one without wrapping below zero.
+void assentWorkDequeInit(AssentWorkDeque* self, struct ImprintAllocator* allocator, size_t capacity)
+{
+    self->capacity = capacity;
+    self->items = IMPRINT_CALLOC_TYPE_COUNT(allocator, uint64_t, capacity);
+    self->top = 1;
+    self->bottom = 1;
+}
+
+/// Owner only.
+/// @return false if the deque is full
+bool assentWorkDequePush(AssentWorkDeque* self, uint64_t item)
+{
+    const uint64_t bottom = self->bottom;
+    const uint64_t top = assentAtomicLoad(&self->top);
+    if (bottom - top >= self->capacity) {
+        return false;
+    }
+
+    assentAtomicStore(&self->items[bottom % self->capacity], item);
+    assentAtomicStore(&self->bottom, bottom + 1);
+
+    return true;
+}
+
+/// Owner only. Takes the most recently pushed item.
+bool assentWorkDequePop(AssentWorkDeque* self, uint64_t* outItem)
+{
+    const uint64_t bottom = self->bottom - 1;
+    assentAtomicStore(&self->bottom, bottom);
+    assentAtomicFence();
+    uint64_t top = assentAtomicLoad(&self->top);
+
+    if (top > bottom) {
+        assentAtomicStore(&self->bottom, bottom + 1);
+        return false;
+    }
+
+    *outItem = assentAtomicLoad(&self->items[bottom % self->capacity]);
+    if (top < bottom) {
+        return true;
+    }
+
+    // last item, race the thieves for it
+    const bool isTaken = assentAtomicCompareExchange(&self->top, &top, top + 1);
+    assentAtomicStore(&self->bottom, bottom + 1);
+
+    return isTaken;
+}
+
+/// Any thread. Takes the oldest item.
+/// @return false if the deque is empty or another thread took the item first
+bool assentWorkDequeSteal(AssentWorkDeque* self, uint64_t* outItem)
+{
+    uint64_t top = assentAtomicLoad(&self->top);
+    assentAtomicFence();
+    const uint64_t bottom = assentAtomicLoad(&self->bottom);
+
+    if (top >= bottom) {
+        return false;
+    }
+
+    *outItem = assentAtomicLoad(&self->items[top % self->capacity]);
+
+    return assentAtomicCompareExchange(&self->top, &top, top + 1);
+}
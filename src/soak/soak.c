@@ -0,0 +1,398 @@
+/*---------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved.
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------*/
+#include "nimble-steps-serialize/out_serialize.h"
+#include <assent/assent.h>
+#include <clog/clog.h>
+#include <clog/console.h>
+#include <imprint/default_setup.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Soak load generator. A deterministic synthetic server produces one combined step per frame, with participants
+// joining and leaving. The steps are sent over a simulated network with loss, jitter and reordering to a client
+// that feeds them to assentAddAuthoritativeStepRaw() and calls assentUpdate() once per frame. Missing steps are
+// requested again using assentMissingSteps(). Time is simulated, so hours of play run as fast as the CPU allows.
+// Backlog, step latency (in simulated time) and CPU time are reported per match.
+
+clog_config g_clog;
+char g_clog_temp_str[CLOG_TEMP_STR_SIZE];
+
+#define SOAK_MAX_PARTICIPANTS (64)
+#define SOAK_MAX_PAYLOAD_OCTET_COUNT (64)
+#define SOAK_HISTORY_STEP_COUNT (1024)
+#define SOAK_MAX_IN_FLIGHT_COUNT (8192)
+#define SOAK_MAX_MISSING_PER_FRAME (32)
+#define SOAK_REORDER_WINDOW_CAPACITY (256)
+
+typedef struct SoakConfig {
+    size_t participantCount;
+    size_t payloadOctetCount;
+    size_t matchCount;
+    double matchMinutes;
+    size_t framesPerSecond;
+    double lossRate;
+    double reorderRate;
+    uint64_t latencyNs;
+    uint64_t jitterNs;
+    double churnPerMinute;
+    uint64_t seed;
+} SoakConfig;
+
+typedef struct SoakPacket {
+    StepId stepId;
+    uint64_t deliverAtNs;
+    bool isUsed;
+} SoakPacket;
+
+typedef struct SoakHistoryStep {
+    StepId stepId;
+    uint64_t producedAtNs;
+    size_t octetCount;
+    uint8_t octets[SOAK_MAX_PARTICIPANTS * (SOAK_MAX_PAYLOAD_OCTET_COUNT + 8) + 8];
+} SoakHistoryStep;
+
+typedef struct SoakMatch {
+    const SoakConfig* config;
+    uint64_t random;
+    uint64_t nowNs;
+    bool isJoined[SOAK_MAX_PARTICIPANTS];
+    bool wasJoined[SOAK_MAX_PARTICIPANTS];
+    SoakHistoryStep history[SOAK_HISTORY_STEP_COUNT];
+    SoakPacket inFlight[SOAK_MAX_IN_FLIGHT_COUNT];
+    uint64_t lastRequestedAtNs[SOAK_HISTORY_STEP_COUNT];
+    AssentLatencyHistogram latencies;
+    uint64_t checksum;
+    size_t packetsSent;
+    size_t packetsLost;
+    size_t packetsDropped;
+    size_t resendsRequested;
+    size_t backlogMax;
+    uint64_t backlogSum;
+} SoakMatch;
+
+static uint64_t soakRandom(SoakMatch* self)
+{
+    // xorshift64*
+    self->random ^= self->random >> 12;
+    self->random ^= self->random << 25;
+    self->random ^= self->random >> 27;
+    return self->random * 0x2545F4914F6CDD1DULL;
+}
+
+static double soakRandomUnit(SoakMatch* self)
+{
+    return (double) (soakRandom(self) >> 11) / 9007199254740992.0;
+}
+
+static void soakDeserialize(void* _self, const TransmuteState* state, StepId stepId)
+{
+    (void) stepId;
+    SoakMatch* self = (SoakMatch*) _self;
+    memcpy(&self->checksum, state->state, sizeof(self->checksum));
+}
+
+static void soakPreTicks(void* _self)
+{
+    (void) _self;
+}
+
+static void soakTick(void* _self, const TransmuteInput* input, StepId stepId)
+{
+    SoakMatch* self = (SoakMatch*) _self;
+
+    for (size_t i = 0; i < input->participantCount; ++i) {
+        const TransmuteParticipantInput* participantInput = &input->participantInputs[i];
+        const uint8_t* octets = (const uint8_t*) participantInput->input;
+        for (size_t j = 0; j < participantInput->octetSize; ++j) {
+            self->checksum = (self->checksum ^ octets[j]) * 0x100000001b3ULL;
+        }
+        self->checksum ^= (uint64_t) participantInput->inputType << 8 | participantInput->participantId;
+    }
+
+    const SoakHistoryStep* produced = &self->history[stepId % SOAK_HISTORY_STEP_COUNT];
+    if (produced->stepId == stepId && self->nowNs >= produced->producedAtNs) {
+        assentLatencyHistogramAdd(&self->latencies, self->nowNs - produced->producedAtNs);
+    }
+}
+
+/// Server side. Produces the combined step for the StepId and keeps it in the history for resends.
+static void produceStep(SoakMatch* self, StepId stepId)
+{
+    const SoakConfig* config = self->config;
+    const double churnPerFrame = config->churnPerMinute / (60.0 * (double) config->framesPerSecond);
+
+    if (soakRandomUnit(self) < churnPerFrame) {
+        const size_t index = (size_t) (soakRandom(self) % config->participantCount);
+        self->isJoined[index] = !self->isJoined[index];
+    }
+
+    uint8_t payloads[SOAK_MAX_PARTICIPANTS][SOAK_MAX_PAYLOAD_OCTET_COUNT];
+    NimbleStepsOutSerializeLocalParticipants participants;
+    participants.participantCount = 0;
+
+    for (size_t i = 0; i < config->participantCount; ++i) {
+        NimbleSerializeStepType stepType;
+        if (self->isJoined[i] && !self->wasJoined[i]) {
+            stepType = NimbleSerializeStepTypeJoined;
+        } else if (!self->isJoined[i] && self->wasJoined[i]) {
+            stepType = NimbleSerializeStepTypeLeft;
+        } else if (self->isJoined[i]) {
+            stepType = NimbleSerializeStepTypeNormal;
+        } else {
+            continue;
+        }
+        self->wasJoined[i] = self->isJoined[i];
+
+        NimbleStepsOutSerializeLocalParticipant* participant =
+            &participants.participants[participants.participantCount++];
+        participant->participantId = (uint8_t) (i + 1);
+        participant->localPartyId = 0;
+        participant->stepType = stepType;
+        participant->payload = 0;
+        participant->payloadCount = 0;
+        if (stepType == NimbleSerializeStepTypeNormal) {
+            for (size_t j = 0; j < config->payloadOctetCount; ++j) {
+                payloads[i][j] = (uint8_t) soakRandom(self);
+            }
+            participant->payload = payloads[i];
+            participant->payloadCount = config->payloadOctetCount;
+        }
+    }
+
+    SoakHistoryStep* step = &self->history[stepId % SOAK_HISTORY_STEP_COUNT];
+    const ssize_t octetCount = nbsStepsOutSerializeCombinedStep(&participants, step->octets, sizeof(step->octets));
+    step->stepId = stepId;
+    step->producedAtNs = self->nowNs;
+    step->octetCount = octetCount < 0 ? 0 : (size_t) octetCount;
+}
+
+/// Network. Drops, delays and reorders the packet.
+static void sendStep(SoakMatch* self, StepId stepId)
+{
+    const SoakConfig* config = self->config;
+
+    self->packetsSent++;
+    if (soakRandomUnit(self) < config->lossRate) {
+        self->packetsLost++;
+        return;
+    }
+
+    uint64_t delayNs = config->latencyNs;
+    if (config->jitterNs != 0) {
+        delayNs += soakRandom(self) % config->jitterNs;
+    }
+    if (soakRandomUnit(self) < config->reorderRate) {
+        // held back long enough to arrive after some of the steps sent later
+        delayNs += 1000000000ULL / config->framesPerSecond * (1 + soakRandom(self) % 4);
+    }
+
+    for (size_t i = 0; i < SOAK_MAX_IN_FLIGHT_COUNT; ++i) {
+        SoakPacket* packet = &self->inFlight[i];
+        if (!packet->isUsed) {
+            packet->isUsed = true;
+            packet->stepId = stepId;
+            packet->deliverAtNs = self->nowNs + delayNs;
+            return;
+        }
+    }
+
+    self->packetsDropped++;
+}
+
+/// Client. Hands the packets that have arrived to Assent.
+static void deliverPackets(SoakMatch* self, Assent* assent)
+{
+    for (size_t i = 0; i < SOAK_MAX_IN_FLIGHT_COUNT; ++i) {
+        SoakPacket* packet = &self->inFlight[i];
+        if (!packet->isUsed || packet->deliverAtNs > self->nowNs) {
+            continue;
+        }
+        packet->isUsed = false;
+        const SoakHistoryStep* step = &self->history[packet->stepId % SOAK_HISTORY_STEP_COUNT];
+        if (step->stepId != packet->stepId) {
+            // too old, the server no longer has it
+            continue;
+        }
+        assentAddAuthoritativeStepRaw(assent, step->octets, step->octetCount, packet->stepId);
+    }
+}
+
+/// Client. Asks for the steps missing in the reorder window, at most once per round trip.
+static void requestMissingSteps(SoakMatch* self, Assent* assent)
+{
+    StepId missing[SOAK_MAX_MISSING_PER_FRAME];
+    const size_t missingCount = assentMissingSteps(assent, missing, SOAK_MAX_MISSING_PER_FRAME);
+    const uint64_t roundTripNs = 2 * self->config->latencyNs + self->config->jitterNs;
+
+    for (size_t i = 0; i < missingCount; ++i) {
+        uint64_t* lastRequestedAtNs = &self->lastRequestedAtNs[missing[i] % SOAK_HISTORY_STEP_COUNT];
+        if (*lastRequestedAtNs != 0 && self->nowNs - *lastRequestedAtNs < roundTripNs) {
+            continue;
+        }
+        *lastRequestedAtNs = self->nowNs;
+        self->resendsRequested++;
+        sendStep(self, missing[i]);
+    }
+}
+
+static void runMatch(const SoakConfig* config, size_t matchIndex)
+{
+    static SoakMatch match;
+    memset(&match, 0, sizeof(match));
+    match.config = config;
+    match.random = config->seed * 0x9E3779B97F4A7C15ULL + matchIndex + 1;
+    for (size_t i = 0; i < config->participantCount; ++i) {
+        match.isJoined[i] = true;
+    }
+    assentLatencyHistogramInit(&match.latencies);
+
+    ImprintDefaultSetup imprint;
+    imprintDefaultSetupInit(&imprint, 64 * 1024 * 1024);
+
+    AssentCallbackVtbl vtbl = {.deserializeFn = soakDeserialize, .preTicksFn = soakPreTicks, .tickFn = soakTick};
+    AssentCallbackObject callbackObject = {.self = &match, .vtbl = &vtbl};
+
+    Clog assentLog;
+    assentLog.config = &g_clog;
+    assentLog.constantPrefix = "Assent";
+
+    AssentSetup setup;
+    memset(&setup, 0, sizeof(setup));
+    setup.allocator = &imprint.slabAllocator.info.allocator;
+    setup.maxTicksPerRead = 8;
+    setup.maxPlayers = config->participantCount;
+    setup.maxStepOctetSizeForSingleParticipant = config->payloadOctetCount;
+    setup.targetBacklog = 2;
+    setup.catchUpUpdateCount = 8;
+    setup.snapshotDirtyTracking = AssentSnapshotDirtyTrackingCompareBlocks;
+    setup.reorderWindowCapacity = SOAK_REORDER_WINDOW_CAPACITY;
+    setup.log = assentLog;
+
+    uint64_t initialChecksum = 0;
+    TransmuteState initialState = {.state = &initialChecksum, .octetSize = sizeof(initialChecksum)};
+    const StepId firstStepId = 1;
+
+    Assent assent;
+    assentInit(&assent, callbackObject, setup, initialState, firstStepId);
+
+    const uint64_t frameNs = 1000000000ULL / config->framesPerSecond;
+    const size_t frameCount = (size_t) (config->matchMinutes * 60.0 * (double) config->framesPerSecond);
+    StepId nextStepId = firstStepId;
+    const clock_t cpuStart = clock();
+
+    for (size_t frame = 0; frame < frameCount; ++frame) {
+        produceStep(&match, nextStepId);
+        sendStep(&match, nextStepId);
+        nextStepId++;
+
+        deliverPackets(&match, &assent);
+        requestMissingSteps(&match, &assent);
+        assentUpdate(&assent);
+
+        const size_t backlog = (size_t) (nextStepId - assent.stepId);
+        match.backlogSum += backlog;
+        if (backlog > match.backlogMax) {
+            match.backlogMax = backlog;
+        }
+        match.nowNs += frameNs;
+    }
+
+    const double cpuSeconds = (double) (clock() - cpuStart) / CLOCKS_PER_SEC;
+    const double simulatedSeconds = (double) frameCount / (double) config->framesPerSecond;
+
+    AssentLatencySummary latency;
+    assentLatencyHistogramSummarize(&match.latencies, &latency);
+    uint64_t duplicateCount;
+    uint64_t staleCount;
+    assentRedundantStepCounts(&assent, &duplicateCount, &staleCount);
+
+    printf("%zu,%zu,%.1f,%u,%u,%zu,%zu,%zu,%zu,%" PRIu64 ",%" PRIu64 ",%.2f,%zu,%.3f,%.3f,%.3f,%.3f,%.6f\n",
+           matchIndex, config->participantCount, simulatedSeconds, nextStepId - firstStepId,
+           assent.stepId - firstStepId, match.packetsSent, match.packetsLost, match.packetsDropped,
+           match.resendsRequested, duplicateCount, staleCount,
+           frameCount == 0 ? 0.0 : (double) match.backlogSum / (double) frameCount, match.backlogMax,
+           (double) latency.p50Ns / 1e6, (double) latency.p99Ns / 1e6, (double) latency.p999Ns / 1e6, cpuSeconds,
+           simulatedSeconds == 0.0 ? 0.0 : cpuSeconds / simulatedSeconds);
+    fflush(stdout);
+
+    assentDestroy(&assent);
+    imprintDefaultSetupDestroy(&imprint);
+}
+
+static void printUsage(void)
+{
+    fprintf(stderr, "usage: assent_soak [--participants n] [--payload octets] [--matches n] [--minutes m]\n"
+                    "                   [--fps n] [--loss rate] [--reorder rate] [--latency-ms ms]\n"
+                    "                   [--jitter-ms ms] [--churn-per-minute n] [--seed n]\n");
+}
+
+int main(int argc, char* argv[])
+{
+    SoakConfig config;
+    config.participantCount = 8;
+    config.payloadOctetCount = 8;
+    config.matchCount = 1;
+    config.matchMinutes = 60.0;
+    config.framesPerSecond = 60;
+    config.lossRate = 0.02;
+    config.reorderRate = 0.05;
+    config.latencyNs = 40000000;
+    config.jitterNs = 30000000;
+    config.churnPerMinute = 2.0;
+    config.seed = 1;
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+        const char* name = argv[i];
+        const char* value = argv[i + 1];
+        if (strcmp(name, "--participants") == 0) {
+            config.participantCount = strtoul(value, 0, 10);
+        } else if (strcmp(name, "--payload") == 0) {
+            config.payloadOctetCount = strtoul(value, 0, 10);
+        } else if (strcmp(name, "--matches") == 0) {
+            config.matchCount = strtoul(value, 0, 10);
+        } else if (strcmp(name, "--minutes") == 0) {
+            config.matchMinutes = strtod(value, 0);
+        } else if (strcmp(name, "--fps") == 0) {
+            config.framesPerSecond = strtoul(value, 0, 10);
+        } else if (strcmp(name, "--loss") == 0) {
+            config.lossRate = strtod(value, 0);
+        } else if (strcmp(name, "--reorder") == 0) {
+            config.reorderRate = strtod(value, 0);
+        } else if (strcmp(name, "--latency-ms") == 0) {
+            config.latencyNs = (uint64_t) (strtod(value, 0) * 1e6);
+        } else if (strcmp(name, "--jitter-ms") == 0) {
+            config.jitterNs = (uint64_t) (strtod(value, 0) * 1e6);
+        } else if (strcmp(name, "--churn-per-minute") == 0) {
+            config.churnPerMinute = strtod(value, 0);
+        } else if (strcmp(name, "--seed") == 0) {
+            config.seed = strtoull(value, 0, 10);
+        } else {
+            printUsage();
+            return 1;
+        }
+    }
+
+    if (config.participantCount == 0 || config.participantCount > SOAK_MAX_PARTICIPANTS ||
+        config.payloadOctetCount == 0 || config.payloadOctetCount > SOAK_MAX_PAYLOAD_OCTET_COUNT ||
+        config.framesPerSecond == 0) {
+        printUsage();
+        return 1;
+    }
+
+    g_clog.log = clog_console;
+
+    printf("match,participants,simulatedSeconds,stepsProduced,stepsTicked,packetsSent,packetsLost,packetsDropped,"
+           "resendsRequested,duplicates,stale,backlogAverage,backlogMax,latencyP50Ms,latencyP99Ms,latencyP999Ms,"
+           "cpuSeconds,cpuPerSimulatedSecond\n");
+
+    for (size_t i = 0; i < config.matchCount; ++i) {
+        runMatch(&config, i);
+    }
+
+    return 0;
+}
@@ -0,0 +1,246 @@
+/*---------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved.
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------*/
+#include "nimble-steps-serialize/out_serialize.h"
+#include <assent/assent.h>
+#include <assent/clock.h>
+#include <clog/clog.h>
+#include <clog/console.h>
+#include <imprint/default_setup.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+
+// Measures steps per second for assentAddAuthoritativeStep(), assentAddAuthoritativeStepRaw() and assentUpdate()
+// over a grid of participant counts and payload sizes, with a no-op and a more realistic tickFn.
+// Results are written to stdout as CSV, or as JSON with --json.
+
+clog_config g_clog;
+char g_clog_temp_str[CLOG_TEMP_STR_SIZE];
+
+#define BENCH_STEPS_PER_ROUND (256)
+#define BENCH_ROUND_COUNT (64)
+#define BENCH_MAX_PARTICIPANTS (64)
+#define BENCH_MAX_PAYLOAD_OCTET_COUNT (64)
+
+typedef struct BenchState {
+    uint64_t positions[BENCH_MAX_PARTICIPANTS];
+    uint64_t checksum;
+} BenchState;
+
+typedef struct BenchResult {
+    const char* tickName;
+    size_t participantCount;
+    size_t payloadOctetCount;
+    double addStepsPerSecond;
+    double addRawStepsPerSecond;
+    double updateStepsPerSecond;
+} BenchResult;
+
+static void benchDeserialize(void* _self, const TransmuteState* state, StepId stepId)
+{
+    (void) stepId;
+    BenchState* self = (BenchState*) _self;
+    memcpy(self, state->state, sizeof(*self));
+}
+
+static void benchPreTicks(void* _self)
+{
+    (void) _self;
+}
+
+static void benchTickNoOp(void* _self, const TransmuteInput* input, StepId stepId)
+{
+    (void) _self;
+    (void) input;
+    (void) stepId;
+}
+
+/// Touches every octet of every participant input and moves the participant, roughly what a small game does.
+static void benchTickRealistic(void* _self, const TransmuteInput* input, StepId stepId)
+{
+    BenchState* self = (BenchState*) _self;
+
+    for (size_t i = 0; i < input->participantCount; ++i) {
+        const TransmuteParticipantInput* participantInput = &input->participantInputs[i];
+        const uint8_t* octets = (const uint8_t*) participantInput->input;
+        uint64_t axis = 0;
+        for (size_t j = 0; j < participantInput->octetSize; ++j) {
+            axis = axis * 31 + octets[j];
+        }
+        self->positions[i] += axis & 0xf;
+        self->checksum = (self->checksum ^ self->positions[i]) * 0x100000001b3ULL;
+    }
+    self->checksum ^= stepId;
+}
+
+static double stepsPerSecond(size_t stepCount, uint64_t durationNs)
+{
+    return durationNs == 0 ? 0.0 : (double) stepCount * 1e9 / (double) durationNs;
+}
+
+static void runCase(BenchResult* result, const char* tickName, AssentAuthoritativeTickFn tickFn,
+                    size_t participantCount, size_t payloadOctetCount)
+{
+    memset(result, 0, sizeof(*result));
+    result->tickName = tickName;
+    result->participantCount = participantCount;
+    result->payloadOctetCount = payloadOctetCount;
+
+    ImprintDefaultSetup imprint;
+    imprintDefaultSetupInit(&imprint, 64 * 1024 * 1024);
+
+    BenchState benchState;
+    memset(&benchState, 0, sizeof(benchState));
+
+    AssentCallbackVtbl vtbl = {.deserializeFn = benchDeserialize, .preTicksFn = benchPreTicks, .tickFn = tickFn};
+    AssentCallbackObject callbackObject = {.self = &benchState, .vtbl = &vtbl};
+
+    Clog assentLog;
+    assentLog.config = &g_clog;
+    assentLog.constantPrefix = "Assent";
+
+    AssentSetup setup;
+    memset(&setup, 0, sizeof(setup));
+    setup.allocator = &imprint.slabAllocator.info.allocator;
+    setup.maxTicksPerRead = 64;
+    setup.maxPlayers = participantCount;
+    setup.maxStepOctetSizeForSingleParticipant = payloadOctetCount;
+    setup.snapshotDirtyTracking = AssentSnapshotDirtyTrackingCompareBlocks;
+    setup.log = assentLog;
+
+    TransmuteState initialState = {.state = &benchState, .octetSize = sizeof(benchState)};
+
+    Assent assent;
+    assentInit(&assent, callbackObject, setup, initialState, 0);
+
+    uint8_t payloads[BENCH_MAX_PARTICIPANTS][BENCH_MAX_PAYLOAD_OCTET_COUNT];
+    TransmuteParticipantInput participantInputs[BENCH_MAX_PARTICIPANTS];
+    for (size_t i = 0; i < participantCount; ++i) {
+        for (size_t j = 0; j < payloadOctetCount; ++j) {
+            payloads[i][j] = (uint8_t) (i * 7 + j);
+        }
+        participantInputs[i].participantId = (uint8_t) (i + 1);
+        participantInputs[i].localPartyId = 0;
+        participantInputs[i].inputType = TransmuteParticipantInputTypeNormal;
+        participantInputs[i].input = payloads[i];
+        participantInputs[i].octetSize = payloadOctetCount;
+    }
+    TransmuteInput input = {.participantInputs = participantInputs, .participantCount = participantCount};
+
+    NimbleStepsOutSerializeLocalParticipants serializeParticipants;
+    for (size_t i = 0; i < participantCount; ++i) {
+        serializeParticipants.participants[i].participantId = participantInputs[i].participantId;
+        serializeParticipants.participants[i].localPartyId = 0;
+        serializeParticipants.participants[i].stepType = NimbleSerializeStepTypeNormal;
+        serializeParticipants.participants[i].payload = payloads[i];
+        serializeParticipants.participants[i].payloadCount = payloadOctetCount;
+    }
+    serializeParticipants.participantCount = participantCount;
+    uint8_t rawStep[BENCH_MAX_PARTICIPANTS * (BENCH_MAX_PAYLOAD_OCTET_COUNT + 8) + 8];
+    const ssize_t rawStepOctetCount = nbsStepsOutSerializeCombinedStep(&serializeParticipants, rawStep,
+                                                                       sizeof(rawStep));
+    if (rawStepOctetCount < 0) {
+        fprintf(stderr, "bench: could not serialize a step of %zu participants with %zu octets each\n",
+                participantCount, payloadOctetCount);
+        assentDestroy(&assent);
+        imprintDefaultSetupDestroy(&imprint);
+        return;
+    }
+
+    uint64_t addNs = 0;
+    uint64_t addRawNs = 0;
+    uint64_t updateNs = 0;
+    size_t addedCount = 0;
+    size_t addedRawCount = 0;
+    size_t updatedCount = 0;
+    StepId stepId = 0;
+
+    for (size_t round = 0; round < BENCH_ROUND_COUNT; ++round) {
+        const bool isRawRound = round % 2 == 1;
+        size_t roundStepCount = 0;
+        const uint64_t addStartNs = assentClockNowNs();
+        // add until the authoritative steps are full, their capacity depends on the nimble-steps version
+        for (; roundStepCount < BENCH_STEPS_PER_ROUND; ++roundStepCount) {
+            const int addResult = isRawRound ? assentAddAuthoritativeStepRaw(&assent, rawStep,
+                                                                            (size_t) rawStepOctetCount, stepId)
+                                             : (int) assentAddAuthoritativeStep(&assent, &input, stepId);
+            if (addResult != 0) {
+                break;
+            }
+            stepId++;
+        }
+        const uint64_t addDurationNs = assentClockNowNs() - addStartNs;
+        if (isRawRound) {
+            addRawNs += addDurationNs;
+            addedRawCount += roundStepCount;
+        } else {
+            addNs += addDurationNs;
+            addedCount += roundStepCount;
+        }
+
+        const StepId stepIdBeforeUpdate = assent.stepId;
+        const uint64_t updateStartNs = assentClockNowNs();
+        while (assent.authoritativeSteps.stepsCount > 0) {
+            if (assentUpdate(&assent) < 0) {
+                break;
+            }
+        }
+        updateNs += assentClockNowNs() - updateStartNs;
+        // only the steps that were actually ticked, an update can fail and leave steps behind
+        updatedCount += assent.stepId - stepIdBeforeUpdate;
+    }
+
+    result->addStepsPerSecond = stepsPerSecond(addedCount, addNs);
+    result->addRawStepsPerSecond = stepsPerSecond(addedRawCount, addRawNs);
+    result->updateStepsPerSecond = stepsPerSecond(updatedCount, updateNs);
+
+    if (assent.stepId != stepId) {
+        fprintf(stderr, "bench: only ticked to %08X of %08X\n", assent.stepId, stepId);
+    }
+
+    assentDestroy(&assent);
+    imprintDefaultSetupDestroy(&imprint);
+}
+
+int main(int argc, char* argv[])
+{
+    static const size_t participantCounts[] = {1, 2, 4, 8, 16, 32, 64};
+    static const size_t payloadOctetCounts[] = {4, 16, 64};
+    static BenchResult results[2 * 7 * 3];
+    size_t resultCount = 0;
+    const bool useJson = argc > 1 && strcmp(argv[1], "--json") == 0;
+
+    g_clog.log = clog_console;
+
+    for (size_t tick = 0; tick < 2; ++tick) {
+        for (size_t p = 0; p < sizeof(participantCounts) / sizeof(participantCounts[0]); ++p) {
+            for (size_t o = 0; o < sizeof(payloadOctetCounts) / sizeof(payloadOctetCounts[0]); ++o) {
+                runCase(&results[resultCount++], tick == 0 ? "noop" : "realistic",
+                        tick == 0 ? benchTickNoOp : benchTickRealistic, participantCounts[p], payloadOctetCounts[o]);
+            }
+        }
+    }
+
+    if (useJson) {
+        printf("[\n");
+        for (size_t i = 0; i < resultCount; ++i) {
+            const BenchResult* r = &results[i];
+            printf("  {\"tick\":\"%s\",\"participants\":%zu,\"payloadOctets\":%zu,\"addStepsPerSecond\":%.0f,"
+                   "\"addRawStepsPerSecond\":%.0f,\"updateStepsPerSecond\":%.0f}%s\n",
+                   r->tickName, r->participantCount, r->payloadOctetCount, r->addStepsPerSecond,
+                   r->addRawStepsPerSecond, r->updateStepsPerSecond, i + 1 < resultCount ? "," : "");
+        }
+        printf("]\n");
+    } else {
+        printf("tick,participants,payloadOctets,addStepsPerSecond,addRawStepsPerSecond,updateStepsPerSecond\n");
+        for (size_t i = 0; i < resultCount; ++i) {
+            const BenchResult* r = &results[i];
+            printf("%s,%zu,%zu,%.0f,%.0f,%.0f\n", r->tickName, r->participantCount, r->payloadOctetCount,
+                   r->addStepsPerSecond, r->addRawStepsPerSecond, r->updateStepsPerSecond);
+        }
+    }
+
+    return 0;
+}
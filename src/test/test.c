@@ -7,7 +7,16 @@
 #include "utest.h"
 
 #include <assent/assent.h>
+#include <assent/clock.h>
+#include <assent/host.h>
+#include <assent/steps_borrow.h>
 #include <imprint/default_setup.h>
+#include <nimble-steps-serialize/out_serialize.h>
+
+#if !defined _WIN32
+#include <pthread.h>
+#include <sched.h>
+#endif
 
 typedef struct AppSpecificState {
     int x;
@@ -157,6 +166,7 @@ UTEST(Assent, verify)
     assentSubLog.constantPrefix = "Assent";
 
     AssentSetup assentSetup;
+    tc_mem_clear_type(&assentSetup);
     assentSetup.allocator = &imprint.slabAllocator.info.allocator;
     assentSetup.maxTicksPerRead = 15;
     assentSetup.maxPlayers = 16;
@@ -191,4 +201,1573 @@ UTEST(Assent, verify)
     ASSERT_EQ(initialStepId + 1, assent.stepId);
     ASSERT_EQ(1, currentAppState->x);
     ASSERT_EQ(1, currentAppState->time);
+
+    const AssentUpdateMetrics* metrics = assentLastUpdateMetrics(&assent);
+    ASSERT_EQ(1, metrics->stepsConsumed);
+    ASSERT_EQ(1, metrics->backlogBefore);
+    ASSERT_EQ(0, metrics->backlogAfter);
+    ASSERT_EQ(1, metrics->participantCount);
+    ASSERT_GT(metrics->octetsParsed, 0);
+
+    AssentMetricsTotals totals;
+    assentMetricsTotals(&assent, &totals);
+    ASSERT_EQ(1, totals.updateCount);
+    ASSERT_EQ(1, totals.stepsConsumed);
+
+    ASSERT_EQ(ASSENT_ADD_STEP_STALE, assentAddAuthoritativeStep(&assent, &transmuteInput, initialStepId));
+    ASSERT_EQ(0, assentAddAuthoritativeStep(&assent, &transmuteInput, initialStepId + 1));
+    ASSERT_EQ(ASSENT_ADD_STEP_DUPLICATE, assentAddAuthoritativeStep(&assent, &transmuteInput, initialStepId + 1));
+
+    uint64_t duplicateCount;
+    uint64_t staleCount;
+    assentRedundantStepCounts(&assent, &duplicateCount, &staleCount);
+    ASSERT_EQ(1, duplicateCount);
+    ASSERT_EQ(1, staleCount);
+}
+
+typedef struct TestBatchCallbackObject {
+    size_t batchCount;
+    size_t tickCount;
+    StepId firstStepId;
+    int horizontalAxisSum;
+} TestBatchCallbackObject;
+
+void assentBatchDeserialize(void* _self, const TransmuteState* state, StepId stepId)
+{
+    (void) _self;
+    (void) state;
+    (void) stepId;
+}
+
+uint64_t assentBatchHash(void* _self)
+{
+    const TestBatchCallbackObject* self = (TestBatchCallbackObject*) _self;
+    return (uint64_t) self->horizontalAxisSum;
+}
+
+void assentBatchTick(void* _self, const TransmuteInput* inputs, size_t inputCount, StepId firstStepId)
+{
+    TestBatchCallbackObject* self = (TestBatchCallbackObject*) _self;
+    self->batchCount++;
+    self->firstStepId = firstStepId;
+    for (size_t i = 0; i < inputCount; ++i) {
+        const AppSpecificParticipantInput* appSpecificInput = (const AppSpecificParticipantInput*) inputs[i]
+                                                                  .participantInputs[0]
+                                                                  .input;
+        self->horizontalAxisSum += appSpecificInput->horizontalAxis;
+        self->tickCount++;
+    }
+}
+
+UTEST(Assent, tickBatch)
+{
+    ImprintDefaultSetup imprint;
+    imprintDefaultSetupInit(&imprint, 16 * 1024 * 1024);
+
+    TestBatchCallbackObject batchCallback = {0, 0, 0, 0};
+
+    AssentCallbackVtbl vtbl = {.deserializeFn = assentBatchDeserialize,
+                               .preTicksFn = assentPreTicks,
+                               .hashFn = assentBatchHash,
+                               .tickBatchFn = assentBatchTick};
+    AssentCallbackObject assentCallbackObject = {.self = &batchCallback, .vtbl = &vtbl};
+
+    AssentSetup assentSetup;
+    tc_mem_clear_type(&assentSetup);
+    assentSetup.allocator = &imprint.slabAllocator.info.allocator;
+    assentSetup.maxTicksPerRead = 2;
+    assentSetup.maxPlayers = 16;
+    assentSetup.maxStepOctetSizeForSingleParticipant = 10;
+    assentSetup.stateHashInterval = 2;
+    assentSetup.stateHashHistoryCount = 4;
+    assentSetup.inputHashHistoryCount = 8;
+    assentSetup.log.config = &g_clog;
+    assentSetup.log.constantPrefix = "Assent";
+
+    AppSpecificState initialAppState = {0, 0};
+    TransmuteState initialTransmuteState = {.state = &initialAppState, .octetSize = sizeof(initialAppState)};
+
+    Assent assent;
+    assentInit(&assent, assentCallbackObject, assentSetup, initialTransmuteState, 42);
+
+    for (StepId i = 0; i < 3; ++i) {
+        AppSpecificParticipantInput gameInput = {.horizontalAxis = (int) i + 1};
+        TransmuteParticipantInput participantInputs[1] = {[0] = {
+                                                              .input = &gameInput,
+                                                              .octetSize = sizeof(gameInput),
+                                                              .participantId = 1,
+                                                              .inputType = TransmuteParticipantInputTypeNormal,
+                                                          }};
+        TransmuteInput transmuteInput = {.participantInputs = participantInputs, .participantCount = 1};
+        assentAddAuthoritativeStep(&assent, &transmuteInput, 42 + i);
+    }
+
+    assentUpdate(&assent);
+    ASSERT_EQ(1, batchCallback.batchCount);
+    ASSERT_EQ(2, batchCallback.tickCount);
+    ASSERT_EQ(42, batchCallback.firstStepId);
+    ASSERT_EQ(3, batchCallback.horizontalAxisSum);
+
+    assentUpdate(&assent);
+    ASSERT_EQ(2, batchCallback.batchCount);
+    ASSERT_EQ(3, batchCallback.tickCount);
+    ASSERT_EQ(44, batchCallback.firstStepId);
+    ASSERT_EQ(6, batchCallback.horizontalAxisSum);
+    ASSERT_EQ(45, assent.stepId);
+
+    uint64_t stateHash;
+    ASSERT_EQ(0, assentStateHash(&assent, 42, &stateHash));
+    ASSERT_EQ(0, stateHash);
+    ASSERT_EQ(0, assentStateHash(&assent, 44, &stateHash));
+    ASSERT_EQ(3, stateHash);
+    ASSERT_EQ(-1, assentStateHash(&assent, 43, &stateHash));
+
+    uint64_t inputHash42;
+    uint64_t inputHash44;
+    ASSERT_EQ(0, assentInputHash(&assent, 42, &inputHash42));
+    ASSERT_EQ(0, assentInputHash(&assent, 44, &inputHash44));
+    ASSERT_NE(inputHash42, inputHash44);
+    ASSERT_EQ(inputHash44, assent.inputHash);
+    ASSERT_EQ(-1, assentInputHash(&assent, 45, &inputHash44));
+}
+
+#define TEST_BORROW_MAX_OCTET_COUNT (40)
+#define TEST_BORROW_MAX_STEPS_PER_ROUND (8)
+
+/// assentStepsBorrow() reads the storage of NbsSteps directly, so check it against nbsStepsRead() for every step,
+/// both in place and where the step wraps around the end of the circular buffer.
+UTEST(Assent, stepsBorrowMatchesRead)
+{
+    ImprintDefaultSetup imprint;
+    imprintDefaultSetupInit(&imprint, 16 * 1024 * 1024);
+
+    Clog log;
+    log.config = &g_clog;
+    log.constantPrefix = "StepsBorrow";
+    NbsSteps steps;
+    nbsStepsInit(&steps, &imprint.slabAllocator.info.allocator, TEST_BORROW_MAX_OCTET_COUNT, log);
+    nbsStepsReInit(&steps, 0);
+
+    uint8_t fallback[TEST_BORROW_MAX_OCTET_COUNT];
+    uint8_t borrowed[TEST_BORROW_MAX_STEPS_PER_ROUND][TEST_BORROW_MAX_OCTET_COUNT];
+    StepId borrowedStepIds[TEST_BORROW_MAX_STEPS_PER_ROUND];
+    int borrowedOctetCounts[TEST_BORROW_MAX_STEPS_PER_ROUND];
+    size_t inPlaceCount = 0;
+    size_t fallbackCount = 0;
+    StepId writeStepId = 0;
+
+    for (size_t round = 0; round < 8 * NBS_WINDOW_SIZE; ++round) {
+        const size_t stepCount = 1 + round % TEST_BORROW_MAX_STEPS_PER_ROUND;
+        for (size_t i = 0; i < stepCount; ++i) {
+            uint8_t octets[TEST_BORROW_MAX_OCTET_COUNT];
+            const size_t octetCount = 1 + (writeStepId * 7U) % TEST_BORROW_MAX_OCTET_COUNT;
+            for (size_t j = 0; j < octetCount; ++j) {
+                octets[j] = (uint8_t) (writeStepId + j);
+            }
+            ASSERT_EQ(0, nbsStepsWrite(&steps, writeStepId, octets, octetCount));
+            writeStepId++;
+        }
+
+        for (size_t i = 0; i < stepCount; ++i) {
+            const uint8_t* octets;
+            borrowedOctetCounts[i] = assentStepsBorrow(&steps, i, &borrowedStepIds[i], &octets, fallback,
+                                                       sizeof(fallback));
+            ASSERT_GT(borrowedOctetCounts[i], 0);
+            tc_memcpy_octets(borrowed[i], octets, (size_t) borrowedOctetCounts[i]);
+            if (octets == fallback) {
+                fallbackCount++;
+            } else {
+                inPlaceCount++;
+            }
+        }
+
+        for (size_t i = 0; i < stepCount; ++i) {
+            StepId readStepId;
+            uint8_t octets[TEST_BORROW_MAX_OCTET_COUNT];
+            const int octetCount = nbsStepsRead(&steps, &readStepId, octets, sizeof(octets));
+            ASSERT_EQ(octetCount, borrowedOctetCounts[i]);
+            ASSERT_EQ(readStepId, borrowedStepIds[i]);
+            ASSERT_EQ(0, tc_memcmp(octets, borrowed[i], (size_t) octetCount));
+        }
+    }
+
+    ASSERT_GT(inPlaceCount, 0);
+    ASSERT_GT(fallbackCount, 0);
+}
+
+UTEST(Assent, storeDecodedSteps)
+{
+    ImprintDefaultSetup imprint;
+    imprintDefaultSetupInit(&imprint, 16 * 1024 * 1024);
+
+    TestBatchCallbackObject batchCallback = {0, 0, 0, 0};
+
+    AssentCallbackVtbl vtbl = {.deserializeFn = assentBatchDeserialize,
+                               .preTicksFn = assentPreTicks,
+                               .tickBatchFn = assentBatchTick};
+    AssentCallbackObject assentCallbackObject = {.self = &batchCallback, .vtbl = &vtbl};
+
+    AssentSetup assentSetup;
+    tc_mem_clear_type(&assentSetup);
+    assentSetup.allocator = &imprint.slabAllocator.info.allocator;
+    assentSetup.maxTicksPerRead = 4;
+    assentSetup.maxPlayers = 2;
+    assentSetup.maxStepOctetSizeForSingleParticipant = 10;
+    assentSetup.snapshotDirtyTracking = AssentSnapshotDirtyTrackingCompareBlocks;
+    assentSetup.decodeAheadCapacity = 4;
+    assentSetup.storeDecodedSteps = true;
+    assentSetup.log.config = &g_clog;
+    assentSetup.log.constantPrefix = "Assent";
+
+    AppSpecificState initialAppState = {0, 0};
+    TransmuteState initialTransmuteState = {.state = &initialAppState, .octetSize = sizeof(initialAppState)};
+
+    Assent assent;
+    assentInit(&assent, assentCallbackObject, assentSetup, initialTransmuteState, 10);
+
+    // added out of order, the input is copied, so it can change after it has been added
+    AppSpecificParticipantInput gameInput;
+    TransmuteParticipantInput participantInputs[1] = {[0] = {
+                                                          .input = &gameInput,
+                                                          .octetSize = sizeof(gameInput),
+                                                          .participantId = 1,
+                                                          .inputType = TransmuteParticipantInputTypeNormal,
+                                                      }};
+    TransmuteInput transmuteInput = {.participantInputs = participantInputs, .participantCount = 1};
+    const StepId stepIds[3] = {11, 10, 12};
+    for (size_t i = 0; i < 3; ++i) {
+        gameInput.horizontalAxis = (int) stepIds[i] - 9;
+        ASSERT_EQ(0, assentAddAuthoritativeStep(&assent, &transmuteInput, stepIds[i]));
+    }
+    ASSERT_EQ(ASSENT_ADD_STEP_DUPLICATE, assentAddAuthoritativeStep(&assent, &transmuteInput, 11));
+    ASSERT_EQ(ASSENT_STEP_INGEST_TOO_FAR_AHEAD, assentAddAuthoritativeStep(&assent, &transmuteInput, 14));
+
+    assentUpdate(&assent);
+    ASSERT_EQ(1, batchCallback.batchCount);
+    ASSERT_EQ(3, batchCallback.tickCount);
+    ASSERT_EQ(10, batchCallback.firstStepId);
+    ASSERT_EQ(6, batchCallback.horizontalAxisSum);
+    ASSERT_EQ(13, assent.stepId);
+
+    const AssentUpdateMetrics* metrics = assentLastUpdateMetrics(&assent);
+    ASSERT_EQ(3, metrics->backlogBefore);
+    ASSERT_EQ(0, metrics->backlogAfter);
+    ASSERT_EQ(3, metrics->stepsPreDecoded);
+    ASSERT_EQ(0, metrics->octetsParsed);
+
+    // the records of the ticked steps can be used again
+    ASSERT_EQ(ASSENT_ADD_STEP_DUPLICATE, assentAddAuthoritativeStep(&assent, &transmuteInput, 12));
+    ASSERT_EQ(0, assentAddAuthoritativeStep(&assent, &transmuteInput, 14));
+
+    uint64_t duplicateCount;
+    uint64_t staleCount;
+    assentRedundantStepCounts(&assent, &duplicateCount, &staleCount);
+    ASSERT_EQ(2, duplicateCount);
+}
+
+typedef struct TestRecordingCallbackObject {
+    StepId stepIds[256];
+    int horizontalAxes[256];
+    size_t tickCount;
+    Assent* assent;
+    StepId addNextStepUntilStepId; // for assentAddingTick
+    size_t snapshotRequestCount;
+    StepId latestReceivedStepId;
+    StepId deserializedStepId;
+} TestRecordingCallbackObject;
+
+void assentRecordingTick(void* _self, const TransmuteInput* input, StepId stepId)
+{
+    TestRecordingCallbackObject* self = (TestRecordingCallbackObject*) _self;
+    if (self->tickCount == sizeof(self->stepIds) / sizeof(self->stepIds[0])) {
+        return;
+    }
+
+    // the payload is not necessarily aligned
+    AppSpecificParticipantInput appSpecificInput;
+    tc_memcpy_octets(&appSpecificInput, input->participantInputs[0].input, sizeof(appSpecificInput));
+    self->stepIds[self->tickCount] = stepId;
+    self->horizontalAxes[self->tickCount] = appSpecificInput.horizontalAxis;
+    self->tickCount++;
+}
+
+void assentRecordingRequestSnapshot(void* _self, StepId latestReceivedStepId)
+{
+    TestRecordingCallbackObject* self = (TestRecordingCallbackObject*) _self;
+    self->snapshotRequestCount++;
+    self->latestReceivedStepId = latestReceivedStepId;
+}
+
+void assentRecordingDeserialize(void* _self, const TransmuteState* state, StepId stepId)
+{
+    (void) state;
+    TestRecordingCallbackObject* self = (TestRecordingCallbackObject*) _self;
+    self->deserializedStepId = stepId;
+}
+
+/// The state is the number of ticks so far.
+int assentRecordingSerialize(void* _self, uint8_t* target, size_t maxTargetOctetSize)
+{
+    const TestRecordingCallbackObject* self = (const TestRecordingCallbackObject*) _self;
+    if (maxTargetOctetSize < sizeof(self->tickCount)) {
+        return -1;
+    }
+    tc_memcpy_octets(target, &self->tickCount, sizeof(self->tickCount));
+
+    return (int) sizeof(self->tickCount);
+}
+
+void assentRecordingTickBatch(void* _self, const TransmuteInput* inputs, size_t inputCount, StepId firstStepId)
+{
+    for (size_t i = 0; i < inputCount; ++i) {
+        assentRecordingTick(_self, &inputs[i], firstStepId + (StepId) i);
+    }
+}
+
+static AssentSetup testAssentSetup(ImprintDefaultSetup* imprint)
+{
+    AssentSetup assentSetup;
+    tc_mem_clear_type(&assentSetup);
+    assentSetup.allocator = &imprint->slabAllocator.info.allocator;
+    assentSetup.maxTicksPerRead = 8;
+    assentSetup.maxPlayers = 2;
+    assentSetup.maxStepOctetSizeForSingleParticipant = 10;
+    assentSetup.snapshotDirtyTracking = AssentSnapshotDirtyTrackingCompareBlocks;
+    assentSetup.log.config = &g_clog;
+    assentSetup.log.constantPrefix = "Assent";
+
+    return assentSetup;
+}
+
+static void testAssentInit(Assent* assent, AssentCallbackObject callbackObject, AssentSetup setup, StepId stepId)
+{
+    static AppSpecificState initialAppState = {0, 0};
+    TransmuteState initialTransmuteState = {.state = &initialAppState, .octetSize = sizeof(initialAppState)};
+
+    assentInit(assent, callbackObject, setup, initialTransmuteState, stepId);
+}
+
+static ssize_t addTestStep(Assent* assent, StepId stepId, int horizontalAxis)
+{
+    AppSpecificParticipantInput gameInput = {.horizontalAxis = horizontalAxis};
+    TransmuteParticipantInput participantInputs[1] = {[0] = {
+                                                          .input = &gameInput,
+                                                          .octetSize = sizeof(gameInput),
+                                                          .participantId = 1,
+                                                          .inputType = TransmuteParticipantInputTypeNormal,
+                                                      }};
+    TransmuteInput transmuteInput = {.participantInputs = participantInputs, .participantCount = 1};
+
+    return assentAddAuthoritativeStep(assent, &transmuteInput, stepId);
+}
+
+/// Serializes a step with one participant, like assentAddAuthoritativeStep() would.
+static size_t serializeTestStep(uint8_t* target, size_t maxOctetCount, int horizontalAxis)
+{
+    AppSpecificParticipantInput gameInput = {.horizontalAxis = horizontalAxis};
+    NimbleStepsOutSerializeLocalParticipants participants;
+    participants.participantCount = 1;
+    participants.participants[0].participantId = 1;
+    participants.participants[0].localPartyId = 0;
+    participants.participants[0].stepType = NimbleSerializeStepTypeNormal;
+    participants.participants[0].payload = (const uint8_t*) &gameInput;
+    participants.participants[0].payloadCount = sizeof(gameInput);
+
+    const ssize_t octetCount = nbsStepsOutSerializeCombinedStep(&participants, target, maxOctetCount);
+
+    return octetCount < 0 ? 0 : (size_t) octetCount;
+}
+
+#define TEST_SLOW_TICK_NS (250000U)
+
+/// Takes at least TEST_SLOW_TICK_NS.
+void assentSlowTick(void* _self, const TransmuteInput* input, StepId stepId)
+{
+    const uint64_t startNs = assentClockNowNs();
+    while (assentClockNowNs() - startNs < TEST_SLOW_TICK_NS) {
+    }
+    assentRecordingTick(_self, input, stepId);
+}
+
+UTEST(Assent, updateWithBudget)
+{
+    ImprintDefaultSetup imprint;
+    imprintDefaultSetupInit(&imprint, 16 * 1024 * 1024);
+
+    TestRecordingCallbackObject recording;
+    tc_mem_clear_type(&recording);
+    AssentCallbackVtbl vtbl = {.deserializeFn = assentBatchDeserialize,
+                               .preTicksFn = assentPreTicks,
+                               .tickFn = assentSlowTick};
+    AssentCallbackObject assentCallbackObject = {.self = &recording, .vtbl = &vtbl};
+
+    Assent assent;
+    testAssentInit(&assent, assentCallbackObject, testAssentSetup(&imprint), 0);
+    for (StepId stepId = 0; stepId < 20; ++stepId) {
+        ASSERT_EQ(0, addTestStep(&assent, stepId, (int) stepId));
+    }
+
+    // a budget of four ticks stops before the fifth, since the next tick is predicted to exceed it
+    AssentUpdateResult result;
+    ASSERT_EQ(0, assentUpdateWithBudget(&assent, 4 * TEST_SLOW_TICK_NS, &result));
+    ASSERT_GE(result.stepsRun, 1);
+    ASSERT_LE(result.stepsRun, 4);
+    ASSERT_EQ(20 - result.stepsRun, result.stepsRemaining);
+    ASSERT_GE(assent.averageTickDurationNs, TEST_SLOW_TICK_NS);
+
+    // a budget smaller than a single tick still ticks one step, so the simulation can not stall
+    size_t stepsRun = result.stepsRun;
+    ASSERT_EQ(0, assentUpdateWithBudget(&assent, 1, &result));
+    ASSERT_EQ(1, result.stepsRun);
+    stepsRun += result.stepsRun;
+    ASSERT_EQ(20 - stepsRun, result.stepsRemaining);
+
+    // and a large one ticks the rest, not limited by maxTicksPerRead
+    ASSERT_EQ(0, assentUpdateWithBudget(&assent, 1000 * TEST_SLOW_TICK_NS, &result));
+    ASSERT_EQ(20 - stepsRun, result.stepsRun);
+    ASSERT_EQ(0, result.stepsRemaining);
+
+    ASSERT_EQ(20, recording.tickCount);
+    ASSERT_EQ(19, recording.stepIds[19]);
+
+    assentDestroy(&assent);
+}
+
+UTEST(Assent, snapshotRing)
+{
+    ImprintDefaultSetup imprint;
+    imprintDefaultSetupInit(&imprint, 16 * 1024 * 1024);
+
+    TestRecordingCallbackObject recording;
+    tc_mem_clear_type(&recording);
+    AssentCallbackVtbl vtbl = {.deserializeFn = assentRecordingDeserialize,
+                               .preTicksFn = assentPreTicks,
+                               .tickFn = assentRecordingTick,
+                               .serializeFn = assentRecordingSerialize};
+    AssentCallbackObject assentCallbackObject = {.self = &recording, .vtbl = &vtbl};
+
+    AssentSetup assentSetup = testAssentSetup(&imprint);
+    assentSetup.snapshotInterval = 4;
+    assentSetup.snapshotCount = 3;
+    assentSetup.maxSnapshotOctetSize = 16;
+    Assent assent;
+    testAssentInit(&assent, assentCallbackObject, assentSetup, 0);
+
+    for (StepId stepId = 0; stepId < 22; ++stepId) {
+        ASSERT_EQ(0, addTestStep(&assent, stepId, (int) stepId));
+    }
+    for (size_t i = 0; i < 3; ++i) {
+        ASSERT_EQ(0, assentUpdate(&assent));
+    }
+    ASSERT_EQ(22, assent.stepId);
+
+    // taken at 0, 4, 8, 12, 16 and 20, only the latest three are kept
+    TransmuteState state;
+    StepId snapshotStepId;
+    size_t tickCount;
+    ASSERT_EQ(0, assentSnapshot(&assent, 18, &state, &snapshotStepId));
+    ASSERT_EQ(16, snapshotStepId);
+    ASSERT_EQ(sizeof(tickCount), state.octetSize);
+    tc_memcpy_octets(&tickCount, state.state, sizeof(tickCount));
+    ASSERT_EQ(16, tickCount);
+
+    ASSERT_EQ(0, assentSnapshot(&assent, 12, &state, &snapshotStepId));
+    ASSERT_EQ(12, snapshotStepId);
+    ASSERT_EQ(0, assentSnapshot(&assent, 30, &state, &snapshotStepId));
+    ASSERT_EQ(20, snapshotStepId);
+    tc_memcpy_octets(&tickCount, state.state, sizeof(tickCount));
+    ASSERT_EQ(20, tickCount);
+
+    ASSERT_EQ(-1, assentSnapshot(&assent, 11, &state, &snapshotStepId));
+    ASSERT_EQ(-1, assentSnapshot(&assent, 0, &state, &snapshotStepId));
+
+    assentDestroy(&assent);
+}
+
+UTEST(Assent, skipToSnapshot)
+{
+    ImprintDefaultSetup imprint;
+    imprintDefaultSetupInit(&imprint, 16 * 1024 * 1024);
+
+    TestRecordingCallbackObject recording;
+    tc_mem_clear_type(&recording);
+    AssentCallbackVtbl vtbl = {.deserializeFn = assentRecordingDeserialize,
+                               .preTicksFn = assentPreTicks,
+                               .tickFn = assentRecordingTick,
+                               .requestSnapshotFn = assentRecordingRequestSnapshot};
+    AssentCallbackObject assentCallbackObject = {.self = &recording, .vtbl = &vtbl};
+
+    AssentSetup assentSetup = testAssentSetup(&imprint);
+    assentSetup.maxTicksPerRead = 2;
+    assentSetup.skipToSnapshotBacklogThreshold = 10;
+    Assent assent;
+    testAssentInit(&assent, assentCallbackObject, assentSetup, 0);
+
+    for (StepId stepId = 0; stepId < 30; ++stepId) {
+        ASSERT_EQ(0, addTestStep(&assent, stepId, (int) stepId));
+    }
+
+    // requested once, and not again while the backlog is simulated, until another threshold worth of steps
+    for (size_t i = 0; i < 5; ++i) {
+        ASSERT_EQ(0, assentUpdate(&assent));
+    }
+    ASSERT_EQ(1, recording.snapshotRequestCount);
+    ASSERT_EQ(29, recording.latestReceivedStepId);
+    ASSERT_EQ(10, assent.stepId);
+
+    AppSpecificState snapshotState = {0, 25};
+    TransmuteState snapshot = {.state = &snapshotState, .octetSize = sizeof(snapshotState)};
+    assentApplySnapshot(&assent, snapshot, 25);
+    ASSERT_EQ(25, recording.deserializedStepId);
+    ASSERT_EQ(25, assent.stepId);
+    ASSERT_FALSE(assent.isSnapshotRequestPending);
+
+    // the steps before the snapshot are gone, ticking resumes at it
+    const size_t tickCountBeforeSnapshot = recording.tickCount;
+    ASSERT_EQ(10, tickCountBeforeSnapshot);
+    ASSERT_EQ(0, assentUpdate(&assent));
+    ASSERT_EQ(0, assentUpdate(&assent));
+    ASSERT_EQ(0, assentUpdate(&assent));
+    ASSERT_EQ(30, assent.stepId);
+    ASSERT_EQ(tickCountBeforeSnapshot + 5, recording.tickCount);
+    for (size_t i = 0; i < 5; ++i) {
+        ASSERT_EQ(25 + (StepId) i, recording.stepIds[tickCountBeforeSnapshot + i]);
+        ASSERT_EQ(25 + (int) i, recording.horizontalAxes[tickCountBeforeSnapshot + i]);
+    }
+    ASSERT_EQ(1, recording.snapshotRequestCount);
+    ASSERT_EQ(ASSENT_ADD_STEP_STALE, addTestStep(&assent, 24, 24));
+
+    assentDestroy(&assent);
+}
+
+UTEST(Assent, stopAtMalformedStep)
+{
+    ImprintDefaultSetup imprint;
+    imprintDefaultSetupInit(&imprint, 16 * 1024 * 1024);
+
+    // one participant more than maxPlayers
+    const uint8_t payload[1] = {7};
+    NimbleStepsOutSerializeLocalParticipants participants;
+    participants.participantCount = 3;
+    for (size_t i = 0; i < participants.participantCount; ++i) {
+        participants.participants[i].participantId = (uint8_t) (i + 1);
+        participants.participants[i].localPartyId = 0;
+        participants.participants[i].stepType = NimbleSerializeStepTypeNormal;
+        participants.participants[i].payload = payload;
+        participants.participants[i].payloadCount = sizeof(payload);
+    }
+    uint8_t malformedStep[64];
+    const ssize_t malformedOctetCount = nbsStepsOutSerializeCombinedStep(&participants, malformedStep,
+                                                                          sizeof(malformedStep));
+    ASSERT_GT(malformedOctetCount, 0);
+
+    for (int useBatch = 0; useBatch < 2; ++useBatch) {
+        TestRecordingCallbackObject recording;
+        tc_mem_clear_type(&recording);
+        AssentCallbackVtbl vtbl = {.deserializeFn = assentRecordingDeserialize,
+                                   .preTicksFn = assentPreTicks,
+                                   .requestSnapshotFn = assentRecordingRequestSnapshot};
+        if (useBatch) {
+            vtbl.tickBatchFn = assentRecordingTickBatch;
+        } else {
+            vtbl.tickFn = assentRecordingTick;
+        }
+        AssentCallbackObject assentCallbackObject = {.self = &recording, .vtbl = &vtbl};
+
+        Assent assent;
+        testAssentInit(&assent, assentCallbackObject, testAssentSetup(&imprint), 20);
+
+        ASSERT_EQ(0, addTestStep(&assent, 20, 1));
+        ASSERT_EQ(0, assentAddAuthoritativeStepRaw(&assent, malformedStep, (size_t) malformedOctetCount, 21));
+        ASSERT_EQ(0, addTestStep(&assent, 22, 3));
+        ASSERT_EQ(0, addTestStep(&assent, 23, 4));
+
+        // the match stops on the malformed step, instead of skipping it and diverging from the other peers
+        ASSERT_LT(assentUpdate(&assent), 0);
+        ASSERT_EQ(21, assent.stepId);
+        ASSERT_EQ(1, recording.tickCount);
+        ASSERT_EQ(1, recording.snapshotRequestCount);
+        ASSERT_EQ(23, recording.latestReceivedStepId);
+        ASSERT_EQ(3, assentLastUpdateMetrics(&assent)->backlogAfter);
+
+        // and stays stopped, without requesting another snapshot, until one is applied
+        ASSERT_LT(assentUpdate(&assent), 0);
+        ASSERT_EQ(21, assent.stepId);
+        ASSERT_EQ(1, recording.tickCount);
+        ASSERT_EQ(1, recording.snapshotRequestCount);
+
+        AppSpecificState snapshotState = {0, 22};
+        TransmuteState snapshot = {.state = &snapshotState, .octetSize = sizeof(snapshotState)};
+        assentApplySnapshot(&assent, snapshot, 22);
+        ASSERT_EQ(22, recording.deserializedStepId);
+
+        ASSERT_EQ(0, assentUpdate(&assent));
+        ASSERT_EQ(24, assent.stepId);
+        ASSERT_EQ(3, recording.tickCount);
+        ASSERT_EQ(20, recording.stepIds[0]);
+        ASSERT_EQ(22, recording.stepIds[1]);
+        ASSERT_EQ(23, recording.stepIds[2]);
+        ASSERT_EQ(4, recording.horizontalAxes[2]);
+
+        AssentMetricsTotals totals;
+        assentMetricsTotals(&assent, &totals);
+        ASSERT_EQ(3, totals.stepsConsumed);
+
+        assentDestroy(&assent);
+    }
+}
+
+/// Packs stepCount serialized steps back to back, with the StepId as the content of each step.
+static size_t packTestSteps(uint8_t* target, size_t maxOctetCount, size_t* octetCounts, StepId firstStepId,
+                            size_t stepCount)
+{
+    size_t totalOctetCount = 0;
+    for (size_t i = 0; i < stepCount; ++i) {
+        octetCounts[i] = serializeTestStep(target + totalOctetCount, maxOctetCount - totalOctetCount,
+                                           (int) (firstStepId + (StepId) i));
+        totalOctetCount += octetCounts[i];
+    }
+
+    return totalOctetCount;
+}
+
+UTEST(Assent, addStepsRaw)
+{
+    ImprintDefaultSetup imprint;
+    imprintDefaultSetupInit(&imprint, 16 * 1024 * 1024);
+
+    uint8_t octets[256];
+    size_t octetCounts[5];
+
+    for (int mode = 0; mode < 4; ++mode) {
+        TestRecordingCallbackObject recording;
+        tc_mem_clear_type(&recording);
+        AssentCallbackVtbl vtbl = {.deserializeFn = assentBatchDeserialize,
+                                   .preTicksFn = assentPreTicks,
+                                   .tickFn = assentRecordingTick};
+        AssentCallbackObject assentCallbackObject = {.self = &recording, .vtbl = &vtbl};
+
+        AssentSetup assentSetup = testAssentSetup(&imprint);
+        assentSetup.concurrentIngestCapacity = mode == 1 ? 16 : 0;
+        assentSetup.multiProducerIngestCapacity = mode == 2 ? 8 : 0;
+        assentSetup.decodeAheadCapacity = mode == 3 ? 8 : 0;
+        assentSetup.storeDecodedSteps = mode == 3;
+        Assent assent;
+        testAssentInit(&assent, assentCallbackObject, assentSetup, 0);
+
+        packTestSteps(octets, sizeof(octets), octetCounts, 0, 5);
+        ASSERT_EQ(5, assentAddAuthoritativeStepsRaw(&assent, 0, octets, octetCounts, 5));
+
+        // 3 and 4 are already received. The concurrent ingest only finds that out in assentUpdate()
+        packTestSteps(octets, sizeof(octets), octetCounts, 3, 5);
+        ASSERT_EQ(mode == 1 ? 5 : 3, assentAddAuthoritativeStepsRaw(&assent, 3, octets, octetCounts, 5));
+
+        // would leave a gap at 8 and 9
+        packTestSteps(octets, sizeof(octets), octetCounts, 10, 2);
+        ASSERT_EQ(-1, assentAddAuthoritativeStepsRaw(&assent, 10, octets, octetCounts, 2));
+
+        ASSERT_EQ(0, assentUpdate(&assent));
+        ASSERT_EQ(8, assent.stepId);
+        ASSERT_EQ(8, recording.tickCount);
+        for (size_t i = 0; i < recording.tickCount; ++i) {
+            ASSERT_EQ((StepId) i, recording.stepIds[i]);
+            ASSERT_EQ((int) i, recording.horizontalAxes[i]);
+        }
+
+        assentDestroy(&assent);
+    }
+}
+
+/// Adds the next step from within tickFn, before looking at the input of the current one.
+void assentAddingTick(void* _self, const TransmuteInput* input, StepId stepId)
+{
+    TestRecordingCallbackObject* self = (TestRecordingCallbackObject*) _self;
+    if (stepId < self->addNextStepUntilStepId) {
+        addTestStep(self->assent, stepId + 1, (int) stepId + 1);
+    }
+    assentRecordingTick(_self, input, stepId);
+}
+
+UTEST(Assent, decodeAhead)
+{
+    ImprintDefaultSetup imprint;
+    imprintDefaultSetupInit(&imprint, 16 * 1024 * 1024);
+
+    for (int useBatch = 0; useBatch < 2; ++useBatch) {
+        TestRecordingCallbackObject recording;
+        tc_mem_clear_type(&recording);
+        AssentCallbackVtbl vtbl = {.deserializeFn = assentBatchDeserialize, .preTicksFn = assentPreTicks};
+        if (useBatch) {
+            vtbl.tickBatchFn = assentRecordingTickBatch;
+        } else {
+            vtbl.tickFn = assentRecordingTick;
+        }
+        AssentCallbackObject assentCallbackObject = {.self = &recording, .vtbl = &vtbl};
+
+        AssentSetup assentSetup = testAssentSetup(&imprint);
+        assentSetup.decodeAheadCapacity = 2;
+        Assent assent;
+        testAssentInit(&assent, assentCallbackObject, assentSetup, 60);
+
+        // the first two steps are decoded when added, the third does not fit in the records and is parsed
+        for (StepId stepId = 60; stepId < 63; ++stepId) {
+            ASSERT_EQ(0, addTestStep(&assent, stepId, (int) stepId));
+        }
+        ASSERT_EQ(0, assentUpdate(&assent));
+        ASSERT_EQ(63, assent.stepId);
+        ASSERT_EQ(3, assentLastUpdateMetrics(&assent)->stepsConsumed);
+        ASSERT_EQ(2, assentLastUpdateMetrics(&assent)->stepsPreDecoded);
+
+        // 64 is decoded, but rejected since 63 is missing. Once 63 is there, 64 is added again with other content
+        // of the same size, and the record of the rejected version must not be used for it
+        uint8_t octets[32];
+        const size_t octetCount = serializeTestStep(octets, sizeof(octets), 1);
+        ASSERT_LT(assentAddAuthoritativeStepRaw(&assent, octets, octetCount, 64), 0);
+        ASSERT_EQ(0, addTestStep(&assent, 63, 63));
+        ASSERT_EQ(octetCount, serializeTestStep(octets, sizeof(octets), 64));
+        ASSERT_EQ(0, assentAddAuthoritativeStepRaw(&assent, octets, octetCount, 64));
+        ASSERT_EQ(0, assentUpdate(&assent));
+        ASSERT_EQ(65, assent.stepId);
+        ASSERT_EQ(1, assentLastUpdateMetrics(&assent)->stepsPreDecoded);
+
+        ASSERT_EQ(5, recording.tickCount);
+        for (size_t i = 0; i < recording.tickCount; ++i) {
+            ASSERT_EQ(60 + (StepId) i, recording.stepIds[i]);
+            ASSERT_EQ(60 + (int) i, recording.horizontalAxes[i]);
+        }
+
+        assentDestroy(&assent);
+    }
+}
+
+UTEST(Assent, rejectUnstorableStep)
+{
+    ImprintDefaultSetup imprint;
+    imprintDefaultSetupInit(&imprint, 16 * 1024 * 1024);
+
+    const uint8_t oversizedStep[256] = {0};
+
+    for (int mode = 0; mode < 3; ++mode) {
+        TestRecordingCallbackObject recording;
+        tc_mem_clear_type(&recording);
+        AssentCallbackVtbl vtbl = {.deserializeFn = assentBatchDeserialize,
+                                   .preTicksFn = assentPreTicks,
+                                   .tickFn = assentRecordingTick};
+        AssentCallbackObject assentCallbackObject = {.self = &recording, .vtbl = &vtbl};
+
+        AssentSetup assentSetup = testAssentSetup(&imprint);
+        assentSetup.concurrentIngestCapacity = mode == 1 ? 8 : 0;
+        assentSetup.multiProducerIngestCapacity = mode == 2 ? 8 : 0;
+        Assent assent;
+        testAssentInit(&assent, assentCallbackObject, assentSetup, 40);
+        ASSERT_LT(assent.writeTempBufferSize, sizeof(oversizedStep));
+
+        // steps that could never be stored are rejected up front, so they can not block the steps after them
+        ASSERT_EQ(-2, assentAddAuthoritativeStepRaw(&assent, oversizedStep, assent.writeTempBufferSize + 1, 40));
+        ASSERT_EQ(-2, assentAddAuthoritativeStepRaw(&assent, oversizedStep, 0, 40));
+
+        uint8_t* target;
+        size_t maxOctetCount;
+        ASSERT_EQ(0, assentReserveAuthoritativeStep(&assent, 40, &target, &maxOctetCount));
+        ASSERT_EQ(-2, assentCommitAuthoritativeStep(&assent, 40, maxOctetCount + 1));
+
+        ASSERT_EQ(0, addTestStep(&assent, 40, 40));
+        ASSERT_EQ(0, addTestStep(&assent, 41, 41));
+        ASSERT_EQ(0, assentUpdate(&assent));
+        ASSERT_EQ(42, assent.stepId);
+        ASSERT_EQ(2, recording.tickCount);
+        ASSERT_EQ(40, recording.horizontalAxes[0]);
+        ASSERT_EQ(41, recording.horizontalAxes[1]);
+
+        assentDestroy(&assent);
+    }
+}
+
+UTEST(Assent, truncatedRawStep)
+{
+    ImprintDefaultSetup imprint;
+    imprintDefaultSetupInit(&imprint, 16 * 1024 * 1024);
+
+    uint8_t octets[32];
+    const size_t octetCount = serializeTestStep(octets, sizeof(octets), 9);
+    ASSERT_GT(octetCount, 2);
+    const size_t truncatedOctetCount = octetCount - 2;
+
+    for (int storeDecodedSteps = 0; storeDecodedSteps < 2; ++storeDecodedSteps) {
+        TestRecordingCallbackObject recording;
+        tc_mem_clear_type(&recording);
+        AssentCallbackVtbl vtbl = {.deserializeFn = assentBatchDeserialize,
+                                   .preTicksFn = assentPreTicks,
+                                   .tickFn = assentRecordingTick};
+        AssentCallbackObject assentCallbackObject = {.self = &recording, .vtbl = &vtbl};
+
+        AssentSetup assentSetup = testAssentSetup(&imprint);
+        assentSetup.decodeAheadCapacity = 4;
+        assentSetup.storeDecodedSteps = storeDecodedSteps;
+        Assent assent;
+        testAssentInit(&assent, assentCallbackObject, assentSetup, 50);
+
+        if (storeDecodedSteps) {
+            // there is nowhere to keep a step that can not be decoded, so it is rejected and can be added again
+            ASSERT_LT(assentAddAuthoritativeStepRaw(&assent, octets, truncatedOctetCount, 50), 0);
+            ASSERT_EQ(0, assentAddAuthoritativeStepRaw(&assent, octets, octetCount, 50));
+            ASSERT_EQ(0, assentUpdate(&assent));
+            ASSERT_EQ(1, recording.tickCount);
+            ASSERT_EQ(9, recording.horizontalAxes[0]);
+        } else {
+            // it gets no record, and the match stops on it when assentUpdate() fails to parse it
+            ASSERT_EQ(0, assentAddAuthoritativeStepRaw(&assent, octets, truncatedOctetCount, 50));
+            ASSERT_EQ(0, assentAddAuthoritativeStepRaw(&assent, octets, octetCount, 51));
+            ASSERT_LT(assentUpdate(&assent), 0);
+            ASSERT_EQ(50, assent.stepId);
+            ASSERT_EQ(0, recording.tickCount);
+
+            AppSpecificState snapshotState = {0, 51};
+            TransmuteState snapshot = {.state = &snapshotState, .octetSize = sizeof(snapshotState)};
+            assentApplySnapshot(&assent, snapshot, 51);
+            ASSERT_EQ(0, assentUpdate(&assent));
+            ASSERT_EQ(1, recording.tickCount);
+            ASSERT_EQ(51, recording.stepIds[0]);
+            ASSERT_EQ(1, assentLastUpdateMetrics(&assent)->stepsPreDecoded);
+        }
+
+        assentDestroy(&assent);
+    }
+}
+
+UTEST(Assent, reserveAndCommitStep)
+{
+    ImprintDefaultSetup imprint;
+    imprintDefaultSetupInit(&imprint, 16 * 1024 * 1024);
+
+    const uint8_t oversizedPayload[40] = {0};
+    TransmuteParticipantInput oversizedParticipantInputs[1] = {[0] = {
+                                                                   .input = oversizedPayload,
+                                                                   .octetSize = sizeof(oversizedPayload),
+                                                                   .participantId = 1,
+                                                                   .inputType = TransmuteParticipantInputTypeNormal,
+                                                               }};
+    const TransmuteInput oversizedInput = {.participantInputs = oversizedParticipantInputs, .participantCount = 1};
+
+    for (int useMultiProducerIngest = 0; useMultiProducerIngest < 2; ++useMultiProducerIngest) {
+        TestRecordingCallbackObject recording;
+        tc_mem_clear_type(&recording);
+        AssentCallbackVtbl vtbl = {.deserializeFn = assentBatchDeserialize,
+                                   .preTicksFn = assentPreTicks,
+                                   .tickFn = assentRecordingTick};
+        AssentCallbackObject assentCallbackObject = {.self = &recording, .vtbl = &vtbl};
+
+        AssentSetup assentSetup = testAssentSetup(&imprint);
+        assentSetup.multiProducerIngestCapacity = useMultiProducerIngest ? 8 : 0;
+        Assent assent;
+        testAssentInit(&assent, assentCallbackObject, assentSetup, 30);
+
+        // serialize straight into the reserved space
+        const uint8_t payload[4] = {5, 0, 0, 0};
+        NimbleStepsOutSerializeLocalParticipants participants;
+        participants.participantCount = 1;
+        participants.participants[0].participantId = 1;
+        participants.participants[0].localPartyId = 0;
+        participants.participants[0].stepType = NimbleSerializeStepTypeNormal;
+        participants.participants[0].payload = payload;
+        participants.participants[0].payloadCount = sizeof(payload);
+
+        uint8_t* target;
+        size_t maxOctetCount;
+        ASSERT_EQ(0, assentReserveAuthoritativeStep(&assent, 30, &target, &maxOctetCount));
+        const ssize_t octetCount = nbsStepsOutSerializeCombinedStep(&participants, target, maxOctetCount);
+        ASSERT_GT(octetCount, 0);
+        ASSERT_EQ(0, assentCommitAuthoritativeStep(&assent, 30, (size_t) octetCount));
+
+        // a step that does not fit gives up its reservation, so it can be added again
+        ASSERT_LT(assentAddAuthoritativeStep(&assent, &oversizedInput, 31), 0);
+        ASSERT_EQ(0, addTestStep(&assent, 31, 6));
+
+        ASSERT_EQ(0, assentReserveAuthoritativeStep(&assent, 32, &target, &maxOctetCount));
+        assentCancelAuthoritativeStep(&assent, 32);
+        ASSERT_EQ(0, addTestStep(&assent, 32, 7));
+
+        ASSERT_EQ(0, assentUpdate(&assent));
+        ASSERT_EQ(33, assent.stepId);
+        ASSERT_EQ(3, recording.tickCount);
+        ASSERT_EQ(5, recording.horizontalAxes[0]);
+        ASSERT_EQ(6, recording.horizontalAxes[1]);
+        ASSERT_EQ(7, recording.horizontalAxes[2]);
+
+        assentDestroy(&assent);
+    }
+
+    // adding steps from within tickFn does not disturb the input of the step being ticked
+    TestRecordingCallbackObject recording;
+    tc_mem_clear_type(&recording);
+    AssentCallbackVtbl vtbl = {.deserializeFn = assentBatchDeserialize,
+                               .preTicksFn = assentPreTicks,
+                               .tickFn = assentAddingTick};
+    AssentCallbackObject assentCallbackObject = {.self = &recording, .vtbl = &vtbl};
+
+    Assent assent;
+    testAssentInit(&assent, assentCallbackObject, testAssentSetup(&imprint), 40);
+    recording.assent = &assent;
+    recording.addNextStepUntilStepId = 99;
+
+    ASSERT_EQ(0, addTestStep(&assent, 40, 40));
+    for (size_t i = 0; i < 60; ++i) {
+        ASSERT_EQ(0, assentUpdate(&assent));
+    }
+    ASSERT_EQ(60, recording.tickCount);
+    for (size_t i = 0; i < recording.tickCount; ++i) {
+        ASSERT_EQ(40 + (StepId) i, recording.stepIds[i]);
+        ASSERT_EQ(40 + (int) i, recording.horizontalAxes[i]);
+    }
+
+    assentDestroy(&assent);
+}
+
+#if !defined _WIN32
+
+#define TEST_INGEST_STEP_COUNT (200)
+
+typedef struct TestSingleProducer {
+    Assent* assent;
+    StepId firstStepId;
+} TestSingleProducer;
+
+static void* testSingleProducerThread(void* _self)
+{
+    const TestSingleProducer* self = (const TestSingleProducer*) _self;
+
+    for (StepId stepId = self->firstStepId; stepId < self->firstStepId + TEST_INGEST_STEP_COUNT; ++stepId) {
+        // the queue is full until assentUpdate() has moved the steps out of it
+        while (addTestStep(self->assent, stepId, (int) stepId) < 0) {
+            sched_yield();
+        }
+    }
+
+    return 0;
+}
+
+UTEST(Assent, concurrentIngestThread)
+{
+    ImprintDefaultSetup imprint;
+    imprintDefaultSetupInit(&imprint, 16 * 1024 * 1024);
+
+    TestRecordingCallbackObject recording;
+    tc_mem_clear_type(&recording);
+    AssentCallbackVtbl vtbl = {.deserializeFn = assentBatchDeserialize,
+                               .preTicksFn = assentPreTicks,
+                               .tickFn = assentRecordingTick};
+    AssentCallbackObject assentCallbackObject = {.self = &recording, .vtbl = &vtbl};
+
+    const StepId firstStepId = 500;
+    AssentSetup assentSetup = testAssentSetup(&imprint);
+    assentSetup.concurrentIngestCapacity = 8;
+    Assent assent;
+    testAssentInit(&assent, assentCallbackObject, assentSetup, firstStepId);
+
+    TestSingleProducer producer = {.assent = &assent, .firstStepId = firstStepId};
+    pthread_t thread;
+    pthread_create(&thread, 0, testSingleProducerThread, &producer);
+
+    while (assent.stepId != firstStepId + TEST_INGEST_STEP_COUNT) {
+        ASSERT_EQ(0, assentUpdate(&assent));
+        sched_yield();
+    }
+    pthread_join(thread, 0);
+
+    ASSERT_EQ(TEST_INGEST_STEP_COUNT, recording.tickCount);
+    for (size_t i = 0; i < recording.tickCount; ++i) {
+        ASSERT_EQ(firstStepId + (StepId) i, recording.stepIds[i]);
+        ASSERT_EQ((int) (firstStepId + i), recording.horizontalAxes[i]);
+    }
+
+    // nothing is left behind in the queue
+    ASSERT_EQ(0, assentUpdate(&assent));
+    ASSERT_EQ(0, assentLastUpdateMetrics(&assent)->backlogBefore);
+
+    assentDestroy(&assent);
+}
+
+typedef struct TestProducer {
+    Assent* assent;
+    size_t producerIndex;
+    StepId firstStepId;
+    size_t addedCount;
+} TestProducer;
+
+/// Every step is added by two of the four producers. The odd producers add them backwards in blocks of eight.
+static void* testProducerThread(void* _self)
+{
+    TestProducer* self = (TestProducer*) _self;
+
+    for (size_t i = 0; i < TEST_INGEST_STEP_COUNT; ++i) {
+        const size_t index = self->producerIndex >= 2 ? i ^ 7U : i;
+        if (index % 2 != self->producerIndex % 2 || index >= TEST_INGEST_STEP_COUNT) {
+            continue;
+        }
+        const StepId stepId = self->firstStepId + (StepId) index;
+        ssize_t result;
+        while ((result = addTestStep(self->assent, stepId, (int) stepId)) == ASSENT_STEP_INGEST_TOO_FAR_AHEAD) {
+            sched_yield();
+        }
+        if (result == 0) {
+            self->addedCount++;
+        }
+    }
+
+    return 0;
+}
+
+UTEST(Assent, multiProducerIngestThreads)
+{
+    ImprintDefaultSetup imprint;
+    imprintDefaultSetupInit(&imprint, 16 * 1024 * 1024);
+
+    TestRecordingCallbackObject recording;
+    tc_mem_clear_type(&recording);
+    AssentCallbackVtbl vtbl = {.deserializeFn = assentBatchDeserialize,
+                               .preTicksFn = assentPreTicks,
+                               .tickFn = assentRecordingTick};
+    AssentCallbackObject assentCallbackObject = {.self = &recording, .vtbl = &vtbl};
+
+    const StepId firstStepId = 1000;
+    AssentSetup assentSetup = testAssentSetup(&imprint);
+    assentSetup.multiProducerIngestCapacity = 32;
+    Assent assent;
+    testAssentInit(&assent, assentCallbackObject, assentSetup, firstStepId);
+
+    TestProducer producers[4];
+    pthread_t threads[4];
+    for (size_t i = 0; i < 4; ++i) {
+        producers[i] = (TestProducer){.assent = &assent, .producerIndex = i, .firstStepId = firstStepId};
+        pthread_create(&threads[i], 0, testProducerThread, &producers[i]);
+    }
+
+    while (assent.stepId != firstStepId + TEST_INGEST_STEP_COUNT) {
+        ASSERT_EQ(0, assentUpdate(&assent));
+        sched_yield();
+    }
+
+    size_t addedCount = 0;
+    for (size_t i = 0; i < 4; ++i) {
+        pthread_join(threads[i], 0);
+        addedCount += producers[i].addedCount;
+    }
+
+    // each step was added once, and the copy from the other producer was dropped
+    ASSERT_EQ(TEST_INGEST_STEP_COUNT, addedCount);
+    ASSERT_EQ(TEST_INGEST_STEP_COUNT, recording.tickCount);
+    for (size_t i = 0; i < recording.tickCount; ++i) {
+        ASSERT_EQ(firstStepId + (StepId) i, recording.stepIds[i]);
+        ASSERT_EQ((int) (firstStepId + i), recording.horizontalAxes[i]);
+    }
+
+    assentDestroy(&assent);
+}
+
+#define TEST_HOST_MATCH_COUNT (4)
+#define TEST_HOST_WORKER_COUNT (2)
+#define TEST_HOST_STEP_COUNT (150)
+
+typedef struct TestHostProducer {
+    AssentHost* host;
+    size_t matchIndex;
+} TestHostProducer;
+
+static void* testHostProducerThread(void* _self)
+{
+    const TestHostProducer* self = (const TestHostProducer*) _self;
+
+    for (StepId stepId = 0; stepId < TEST_HOST_STEP_COUNT; ++stepId) {
+        uint8_t octets[32];
+        const size_t octetCount = serializeTestStep(octets, sizeof(octets), (int) stepId);
+        // the ingest is full until the workers have caught up
+        while (assentHostAddAuthoritativeStepRaw(self->host, self->matchIndex, octets, octetCount, stepId) < 0) {
+            sched_yield();
+        }
+    }
+
+    return 0;
+}
+
+typedef struct TestHostWorker {
+    AssentHost* host;
+    size_t workerIndex;
+    volatile uint64_t* isDone;
+} TestHostWorker;
+
+static void* testHostWorkerThread(void* _self)
+{
+    const TestHostWorker* self = (const TestHostWorker*) _self;
+
+    while (!assentAtomicLoad(self->isDone)) {
+        if (assentHostWork(self->host, self->workerIndex, 16) == 0) {
+            sched_yield();
+        }
+    }
+
+    return 0;
+}
+
+UTEST(Assent, hostTicksEveryStepOnce)
+{
+    ImprintDefaultSetup imprint;
+    imprintDefaultSetupInit(&imprint, 16 * 1024 * 1024);
+
+    AssentCallbackVtbl vtbl = {.deserializeFn = assentBatchDeserialize,
+                               .preTicksFn = assentPreTicks,
+                               .tickFn = assentRecordingTick};
+
+    for (int scheduling = 0; scheduling < 2; ++scheduling) {
+        static TestRecordingCallbackObject recordings[TEST_HOST_MATCH_COUNT];
+        static Assent assents[TEST_HOST_MATCH_COUNT];
+        AssentHost host;
+        assentHostInit(&host, &imprint.slabAllocator.info.allocator, TEST_HOST_MATCH_COUNT, TEST_HOST_WORKER_COUNT,
+                       scheduling == 0 ? AssentHostSchedulingWorkStealing : AssentHostSchedulingEarliestDeadline);
+
+        // one match of each ingest mode, and an extra multi-producer one
+        for (size_t i = 0; i < TEST_HOST_MATCH_COUNT; ++i) {
+            tc_mem_clear_type(&recordings[i]);
+            AssentSetup assentSetup = testAssentSetup(&imprint);
+            assentSetup.maxTicksPerRead = 4;
+            if (i == 1) {
+                assentSetup.concurrentIngestCapacity = 16;
+            } else if (i == 2) {
+                assentSetup.decodeAheadCapacity = 16;
+                assentSetup.storeDecodedSteps = true;
+            } else {
+                assentSetup.multiProducerIngestCapacity = 16;
+            }
+            AssentCallbackObject assentCallbackObject = {.self = &recordings[i], .vtbl = &vtbl};
+            testAssentInit(&assents[i], assentCallbackObject, assentSetup, 0);
+            const AssentHostMatchPolicy policy = {.latencyTargetNs = 1000000ULL * (i + 1)};
+            ASSERT_EQ((int) i, assentHostAddMatch(&host, &assents[i], &policy));
+        }
+
+        volatile uint64_t isDone = 0;
+        TestHostWorker workers[TEST_HOST_WORKER_COUNT];
+        pthread_t workerThreads[TEST_HOST_WORKER_COUNT];
+        for (size_t i = 0; i < TEST_HOST_WORKER_COUNT; ++i) {
+            workers[i] = (TestHostWorker){.host = &host, .workerIndex = i, .isDone = &isDone};
+            pthread_create(&workerThreads[i], 0, testHostWorkerThread, &workers[i]);
+        }
+
+        TestHostProducer producers[TEST_HOST_MATCH_COUNT];
+        pthread_t producerThreads[TEST_HOST_MATCH_COUNT];
+        for (size_t i = 0; i < TEST_HOST_MATCH_COUNT; ++i) {
+            producers[i] = (TestHostProducer){.host = &host, .matchIndex = i};
+            pthread_create(&producerThreads[i], 0, testHostProducerThread, &producers[i]);
+        }
+        for (size_t i = 0; i < TEST_HOST_MATCH_COUNT; ++i) {
+            pthread_join(producerThreads[i], 0);
+        }
+
+        // every step has been added and its match scheduled, wait for the workers to tick them all
+        for (size_t i = 0; i < TEST_HOST_MATCH_COUNT; ++i) {
+            AssentMetricsTotals totals;
+            assentMetricsTotals(&assents[i], &totals);
+            while (totals.stepsConsumed != TEST_HOST_STEP_COUNT) {
+                sched_yield();
+                assentMetricsTotals(&assents[i], &totals);
+            }
+        }
+        assentAtomicStore(&isDone, 1);
+        for (size_t i = 0; i < TEST_HOST_WORKER_COUNT; ++i) {
+            pthread_join(workerThreads[i], 0);
+        }
+
+        for (size_t i = 0; i < TEST_HOST_MATCH_COUNT; ++i) {
+            ASSERT_EQ(TEST_HOST_STEP_COUNT, assents[i].stepId);
+            ASSERT_EQ(TEST_HOST_STEP_COUNT, recordings[i].tickCount);
+            for (size_t j = 0; j < recordings[i].tickCount; ++j) {
+                ASSERT_EQ((StepId) j, recordings[i].stepIds[j]);
+                ASSERT_EQ((int) j, recordings[i].horizontalAxes[j]);
+            }
+        }
+    }
+}
+
+#endif
+
+UTEST(Assent, tickRateController)
+{
+    AssentTickRateController controller;
+    assentTickRateControllerInit(&controller, 2, 4, 15);
+
+    ASSERT_EQ(0, assentTickRateControllerChoose(&controller, 1));
+    ASSERT_EQ(0, assentTickRateControllerChoose(&controller, 2));
+    ASSERT_EQ(1, assentTickRateControllerChoose(&controller, 3));
+
+    // A burst of 22 steps above the target is drained evenly over the next four updates, not in one, while a new
+    // step arrives every update
+    size_t backlog = 24;
+    for (size_t i = 0; i < 4; ++i) {
+        const size_t tickCount = assentTickRateControllerChoose(&controller, backlog);
+        ASSERT_EQ(tickCount, controller.lastTickCount);
+        ASSERT_GE(tickCount, 6);
+        ASSERT_LE(tickCount, 7);
+        backlog -= tickCount;
+        backlog++;
+    }
+    ASSERT_EQ(3, backlog);
+    ASSERT_EQ(1, assentTickRateControllerChoose(&controller, backlog));
+
+    // without new steps the excess is still gone after four updates
+    backlog = 24;
+    for (size_t i = 0; i < 4; ++i) {
+        backlog -= assentTickRateControllerChoose(&controller, backlog);
+    }
+    ASSERT_EQ(2, backlog);
+    ASSERT_EQ(0, assentTickRateControllerChoose(&controller, backlog));
+}
+
+UTEST(Assent, tickRateControllerUpdate)
+{
+    ImprintDefaultSetup imprint;
+    imprintDefaultSetupInit(&imprint, 16 * 1024 * 1024);
+
+    TestRecordingCallbackObject recording;
+    tc_mem_clear_type(&recording);
+    AssentCallbackVtbl vtbl = {.deserializeFn = assentRecordingDeserialize,
+                               .preTicksFn = assentPreTicks,
+                               .tickFn = assentRecordingTick,
+                               .requestSnapshotFn = assentRecordingRequestSnapshot};
+    AssentCallbackObject assentCallbackObject = {.self = &recording, .vtbl = &vtbl};
+
+    AssentSetup assentSetup = testAssentSetup(&imprint);
+    assentSetup.targetBacklog = 2;
+    assentSetup.catchUpUpdateCount = 4;
+    assentSetup.skipToSnapshotBacklogThreshold = 1;
+    assentSetup.multiProducerIngestCapacity = 8;
+    Assent assent;
+    testAssentInit(&assent, assentCallbackObject, assentSetup, 0);
+
+    ASSERT_EQ(0, addTestStep(&assent, 0, 0));
+    ASSERT_EQ(0, addTestStep(&assent, 1, 1));
+
+    // nothing is ticked while the backlog is at the target, but the ingest is still drained and the snapshot
+    // request still made
+    ASSERT_EQ(0, assentUpdate(&assent));
+    ASSERT_EQ(0, assentLastUpdateMetrics(&assent)->maxStepCount);
+    ASSERT_EQ(0, assentLastUpdateMetrics(&assent)->stepsConsumed);
+    ASSERT_EQ(2, assentLastUpdateMetrics(&assent)->backlogBefore);
+    ASSERT_EQ(0, recording.tickCount);
+    ASSERT_EQ(1, recording.snapshotRequestCount);
+    ASSERT_EQ(1, recording.latestReceivedStepId);
+
+    ASSERT_EQ(0, addTestStep(&assent, 2, 2));
+    ASSERT_EQ(0, assentUpdate(&assent));
+    ASSERT_EQ(1, assentLastUpdateMetrics(&assent)->maxStepCount);
+    ASSERT_EQ(1, assentLastUpdateMetrics(&assent)->stepsConsumed);
+    ASSERT_EQ(1, recording.tickCount);
+    ASSERT_EQ(0, recording.stepIds[0]);
+
+    assentDestroy(&assent);
+}
+
+UTEST(Assent, stepTreeDivergence)
+{
+    ImprintDefaultSetup imprint;
+    imprintDefaultSetupInit(&imprint, 16 * 1024 * 1024);
+
+    AssentStepTree local;
+    AssentStepTree remote;
+    assentStepTreeInit(&local, &imprint.slabAllocator.info.allocator, 16);
+    assentStepTreeInit(&remote, &imprint.slabAllocator.info.allocator, 16);
+
+    const StepId firstStepId = 30;
+    const StepId divergentStepId = 50;
+    for (StepId stepId = firstStepId; stepId < 60; ++stepId) {
+        assentStepTreeAdd(&local, stepId, stepId * 31U);
+        assentStepTreeAdd(&remote, stepId, stepId == divergentStepId ? 1U : stepId * 31U);
+    }
+
+    uint64_t digest;
+    ASSERT_EQ(-1, assentStepTreeDigest(&local, 0, 40, &digest)); // has been overwritten by step 56
+    ASSERT_EQ(-1, assentStepTreeDigest(&local, 2, 50, &digest)); // not aligned
+    ASSERT_EQ(-1, assentStepTreeDigest(&local, 2, 60, &digest)); // not consumed yet
+    ASSERT_EQ(-1, assentStepTreeDigest(&local, 4, 48, &digest)); // not complete
+
+    // walk down from the widest range that covers the divergent step
+    size_t level = 3;
+    StepId rangeStart = 48;
+    uint64_t localDigest;
+    uint64_t remoteDigest;
+    ASSERT_EQ(0, assentStepTreeDigest(&local, level, rangeStart, &localDigest));
+    ASSERT_EQ(0, assentStepTreeDigest(&remote, level, rangeStart, &remoteDigest));
+    ASSERT_NE(localDigest, remoteDigest);
+
+    while (level > 0) {
+        level--;
+        assentStepTreeDigest(&local, level, rangeStart, &localDigest);
+        assentStepTreeDigest(&remote, level, rangeStart, &remoteDigest);
+        if (localDigest == remoteDigest) {
+            rangeStart += (StepId) 1 << level;
+        }
+    }
+
+    ASSERT_EQ(divergentStepId, rangeStart);
+}
+
+UTEST(Assent, incrementalSnapshots)
+{
+    ImprintDefaultSetup imprint;
+    imprintDefaultSetupInit(&imprint, 16 * 1024 * 1024);
+
+    AssentSnapshots snapshots;
+    assentSnapshotsInit(&snapshots, &imprint.slabAllocator.info.allocator, 4, 64);
+    assentSnapshotsInitIncremental(&snapshots, &imprint.slabAllocator.info.allocator, 8, 3,
+                                   AssentSnapshotDirtyTrackingCompareBlocks);
+
+    uint8_t state[60];
+    for (size_t i = 0; i < sizeof(state); ++i) {
+        state[i] = (uint8_t) i;
+    }
+
+    for (StepId stepId = 0; stepId < 6; ++stepId) {
+        state[stepId * 9] = (uint8_t) (0x80 + stepId);
+        uint8_t* target = assentSnapshotsIncrementalTarget(&snapshots);
+        tc_memcpy_octets(target, state, sizeof(state));
+        assentSnapshotsCommitIncremental(&snapshots, stepId * 10, sizeof(state));
+    }
+
+    // keyframes at 0 and 30, only the changed block is stored for the others
+    const AssentSnapshot* snapshot = assentSnapshotsFindAtOrBefore(&snapshots, 55);
+    ASSERT_EQ(50, snapshot->stepId);
+    ASSERT_FALSE(snapshot->isKeyframe);
+    ASSERT_EQ(4 + 8, snapshot->octetCount);
+
+    const uint8_t* restoredOctets;
+    size_t restoredOctetCount;
+    ASSERT_EQ(0, assentSnapshotsRestore(&snapshots, snapshot, &restoredOctets, &restoredOctetCount));
+    ASSERT_EQ(sizeof(state), restoredOctetCount);
+    ASSERT_EQ(0, tc_memcmp(restoredOctets, state, sizeof(state)));
+
+    // the keyframe at 0 has been overwritten, so 20 can not be restored
+    snapshot = assentSnapshotsFindAtOrBefore(&snapshots, 20);
+    ASSERT_EQ(20, snapshot->stepId);
+    ASSERT_EQ(-1, assentSnapshotsRestore(&snapshots, snapshot, &restoredOctets, &restoredOctetCount));
+}
+
+UTEST(Assent, reorderWindow)
+{
+    ImprintDefaultSetup imprint;
+    imprintDefaultSetupInit(&imprint, 16 * 1024 * 1024);
+
+    AssentReorderWindow window;
+    assentReorderWindowInit(&window, &imprint.slabAllocator.info.allocator, 60, 4, 100);
+    ASSERT_EQ(64, window.capacity);
+
+    const uint8_t octets[4] = {1, 2, 3, 4};
+    ASSERT_EQ(0, assentReorderWindowInsert(&window, 103, octets, 3));
+    ASSERT_EQ(0, assentReorderWindowInsert(&window, 101, octets, 1));
+    ASSERT_EQ(ASSENT_REORDER_WINDOW_STALE, assentReorderWindowInsert(&window, 101, octets, 1));
+    ASSERT_EQ(ASSENT_REORDER_WINDOW_STALE, assentReorderWindowInsert(&window, 99, octets, 1));
+    ASSERT_EQ(ASSENT_REORDER_WINDOW_TOO_FAR_AHEAD, assentReorderWindowInsert(&window, 164, octets, 1));
+
+    StepId missing[4];
+    ASSERT_EQ(2, assentReorderWindowMissing(&window, missing, 4));
+    ASSERT_EQ(100, missing[0]);
+    ASSERT_EQ(102, missing[1]);
+
+    const uint8_t* peekOctets;
+    size_t peekOctetCount;
+    ASSERT_FALSE(assentReorderWindowPeek(&window, &peekOctets, &peekOctetCount));
+
+    assentReorderWindowSkipTo(&window, 101);
+    ASSERT_TRUE(assentReorderWindowPeek(&window, &peekOctets, &peekOctetCount));
+    ASSERT_EQ(1, peekOctetCount);
+
+    assentReorderWindowSkipTo(&window, 103);
+    ASSERT_TRUE(assentReorderWindowPeek(&window, &peekOctets, &peekOctetCount));
+    ASSERT_EQ(3, peekOctetCount);
+    ASSERT_EQ(3, peekOctets[2]);
+
+    assentReorderWindowSkipTo(&window, 104);
+    ASSERT_EQ(0, window.count);
+    ASSERT_EQ(0, assentReorderWindowMissing(&window, missing, 4));
+}
+
+UTEST(Assent, latencyHistogram)
+{
+    AssentLatencyHistogram histogram;
+    assentLatencyHistogramInit(&histogram);
+
+    for (uint64_t i = 1; i <= 1000; ++i) {
+        assentLatencyHistogramAdd(&histogram, i * 1000);
+    }
+
+    AssentLatencySummary summary;
+    assentLatencyHistogramSummarize(&histogram, &summary);
+    ASSERT_EQ(1000, summary.count);
+    // reported values are the upper bound of the bucket, at most 25% above the real value
+    ASSERT_GE(summary.p50Ns, 500000);
+    ASSERT_LE(summary.p50Ns, 625000);
+    ASSERT_GE(summary.p99Ns, 990000);
+    ASSERT_LE(summary.p99Ns, 1237500);
+    ASSERT_GE(summary.p999Ns, summary.p99Ns);
+    ASSERT_GE(summary.maxNs, 1000000);
+
+    assentLatencyHistogramReset(&histogram);
+    assentLatencyHistogramSummarize(&histogram, &summary);
+    ASSERT_EQ(0, summary.count);
+    ASSERT_EQ(0, summary.p99Ns);
+}
+
+UTEST(Assent, traceChromeJson)
+{
+    ImprintDefaultSetup imprint;
+    imprintDefaultSetupInit(&imprint, 16 * 1024 * 1024);
+
+    AssentTrace trace;
+    assentTraceInit(&trace, &imprint.slabAllocator.info.allocator, 2);
+
+    assentTraceAdd(&trace, AssentTraceEventTypeIngest, 1000, 500, 41, 12);
+    assentTraceAdd(&trace, AssentTraceEventTypeParse, 2000, 250, 42, 12);
+    assentTraceAdd(&trace, AssentTraceEventTypeTick, 3500, 1500, 42, 1);
+
+    char json[1024];
+    const int octetCount = assentTraceWriteChromeJson(&trace, json, sizeof(json));
+    ASSERT_GT(octetCount, 0);
+    // the oldest span has been overwritten
+    ASSERT_TRUE(strstr(json, "\"ingest\"") == 0);
+    ASSERT_TRUE(strstr(json, "\"name\":\"parse\"") != 0);
+    ASSERT_TRUE(strstr(json, "\"ts\":3.500,\"dur\":1.500,\"args\":{\"stepId\":42,\"count\":1}") != 0);
+
+    ASSERT_EQ(-1, assentTraceWriteChromeJson(&trace, json, 16));
+}
+
+UTEST(Assent, workDequeAndReadyQueue)
+{
+    ImprintDefaultSetup imprint;
+    imprintDefaultSetupInit(&imprint, 16 * 1024 * 1024);
+
+    AssentWorkDeque deque;
+    assentWorkDequeInit(&deque, &imprint.slabAllocator.info.allocator, 2);
+
+    uint64_t item;
+    ASSERT_FALSE(assentWorkDequePop(&deque, &item));
+    ASSERT_TRUE(assentWorkDequePush(&deque, 10));
+    ASSERT_TRUE(assentWorkDequePush(&deque, 11));
+    ASSERT_FALSE(assentWorkDequePush(&deque, 12));
+
+    // the owner takes the newest, thieves the oldest
+    ASSERT_TRUE(assentWorkDequeSteal(&deque, &item));
+    ASSERT_EQ(10, item);
+    ASSERT_TRUE(assentWorkDequePop(&deque, &item));
+    ASSERT_EQ(11, item);
+    ASSERT_FALSE(assentWorkDequeSteal(&deque, &item));
+
+    AssentReadyQueue queue;
+    assentReadyQueueInit(&queue, &imprint.slabAllocator.info.allocator, 2);
+
+    ASSERT_FALSE(assentReadyQueueDequeue(&queue, &item));
+    ASSERT_TRUE(assentReadyQueueEnqueue(&queue, 20));
+    ASSERT_TRUE(assentReadyQueueEnqueue(&queue, 21));
+    ASSERT_FALSE(assentReadyQueueEnqueue(&queue, 22));
+    ASSERT_TRUE(assentReadyQueueDequeue(&queue, &item));
+    ASSERT_EQ(20, item);
+    ASSERT_TRUE(assentReadyQueueEnqueue(&queue, 22));
+    ASSERT_TRUE(assentReadyQueueDequeue(&queue, &item));
+    ASSERT_EQ(21, item);
+    ASSERT_TRUE(assentReadyQueueDequeue(&queue, &item));
+    ASSERT_EQ(22, item);
+}
+
+typedef struct TestHostMatches {
+    TestRecordingCallbackObject recordings[2];
+    AssentCallbackVtbl vtbl;
+    Assent assents[2];
+    AssentHost host;
+} TestHostMatches;
+
+/// Two matches on an earliest deadline host with one worker, each with a step waiting since readySinceNs.
+static void testHostMatchesInit(TestHostMatches* self, ImprintDefaultSetup* imprint,
+                                const AssentHostMatchPolicy* policies, const uint64_t* readySinceNs)
+{
+    tc_mem_clear_type(self);
+    self->vtbl = (AssentCallbackVtbl){.deserializeFn = assentBatchDeserialize,
+                                      .preTicksFn = assentPreTicks,
+                                      .tickFn = assentRecordingTick};
+    assentHostInit(&self->host, &imprint->slabAllocator.info.allocator, 2, 1, AssentHostSchedulingEarliestDeadline);
+
+    AssentSetup assentSetup = testAssentSetup(imprint);
+    assentSetup.multiProducerIngestCapacity = 8;
+    for (size_t i = 0; i < 2; ++i) {
+        AssentCallbackObject assentCallbackObject = {.self = &self->recordings[i], .vtbl = &self->vtbl};
+        testAssentInit(&self->assents[i], assentCallbackObject, assentSetup, 0);
+        assentHostAddMatch(&self->host, &self->assents[i], &policies[i]);
+        addTestStep(&self->assents[i], 0, 1);
+        assentHostMatchReady(&self->host, i);
+        // as if the step had arrived at that time
+        self->host.matches[i].readySinceNs = readySinceNs[i];
+    }
+}
+
+/// Runs a single update, and tells which match it was for.
+static size_t testHostRunOne(TestHostMatches* self)
+{
+    const size_t tickCountBefore = self->recordings[1].tickCount;
+    assentHostWork(&self->host, 0, 1);
+    return self->recordings[1].tickCount != tickCountBefore ? 1 : 0;
+}
+
+UTEST(Assent, hostEarliestDeadline)
+{
+    ImprintDefaultSetup imprint;
+    imprintDefaultSetupInit(&imprint, 16 * 1024 * 1024);
+
+    const uint64_t secondNs = 1000000000ULL;
+    const uint64_t nowNs = assentClockNowNs();
+    ASSERT_GT(nowNs, 10 * secondNs);
+
+    // the match that has to be ticked soonest goes first, even if it became ready later
+    {
+        const AssentHostMatchPolicy policies[2] = {{.latencyTargetNs = 5 * secondNs},
+                                                   {.latencyTargetNs = 2 * secondNs}};
+        const uint64_t readySinceNs[2] = {nowNs, nowNs + secondNs / 2};
+        TestHostMatches matches;
+        testHostMatchesInit(&matches, &imprint, policies, readySinceNs);
+        ASSERT_EQ(1, testHostRunOne(&matches));
+        ASSERT_EQ(0, testHostRunOne(&matches));
+        ASSERT_EQ(0, assentHostWork(&matches.host, 0, 1));
+        ASSERT_EQ(0, matches.host.matches[0].missedDeadlineCount);
+        ASSERT_EQ(0, matches.host.matches[1].missedDeadlineCount);
+    }
+
+    // when overloaded, the overdue match with the highest priority goes first
+    {
+        const AssentHostMatchPolicy policies[2] = {{.latencyTargetNs = secondNs, .priority = 1},
+                                                   {.latencyTargetNs = secondNs, .priority = 2}};
+        const uint64_t readySinceNs[2] = {nowNs - 4 * secondNs, nowNs - 2 * secondNs};
+        TestHostMatches matches;
+        testHostMatchesInit(&matches, &imprint, policies, readySinceNs);
+        ASSERT_EQ(1, testHostRunOne(&matches));
+        ASSERT_EQ(0, testHostRunOne(&matches));
+        ASSERT_EQ(1, matches.host.matches[0].missedDeadlineCount);
+        ASSERT_EQ(1, matches.host.matches[1].missedDeadlineCount);
+    }
+
+    // but not before a match that has waited longer than its maxWaitNs, so low priority matches do not starve
+    {
+        const AssentHostMatchPolicy policies[2] = {{.latencyTargetNs = secondNs, .priority = 1, .maxWaitNs = secondNs},
+                                                   {.latencyTargetNs = secondNs, .priority = 2}};
+        const uint64_t readySinceNs[2] = {nowNs - 4 * secondNs, nowNs - 2 * secondNs};
+        TestHostMatches matches;
+        testHostMatchesInit(&matches, &imprint, policies, readySinceNs);
+        ASSERT_EQ(0, testHostRunOne(&matches));
+        ASSERT_EQ(1, testHostRunOne(&matches));
+    }
+
+    // only the match whose deadline had passed when it was picked is counted as missed
+    {
+        const AssentHostMatchPolicy policies[2] = {{.latencyTargetNs = secondNs / 1000},
+                                                   {.latencyTargetNs = 60 * secondNs}};
+        const uint64_t readySinceNs[2] = {nowNs - secondNs, nowNs};
+        TestHostMatches matches;
+        testHostMatchesInit(&matches, &imprint, policies, readySinceNs);
+        ASSERT_EQ(0, testHostRunOne(&matches));
+        ASSERT_EQ(1, testHostRunOne(&matches));
+        ASSERT_EQ(1, matches.host.matches[0].missedDeadlineCount);
+        ASSERT_EQ(0, matches.host.matches[1].missedDeadlineCount);
+    }
 }